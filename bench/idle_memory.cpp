@@ -0,0 +1,134 @@
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#include <arpa/inet.h>
+#include <malloc.h>
+#include <sys/resource.h>
+
+#include <SafetyTcpConn/SafetyTcpConn.hpp>
+
+using namespace SafetyTcpConn;
+
+// Memory per idle connection.
+// Opens `count` loopback connections, each sends one heartbeat and gets one reply, then stays idle.
+// Heap growth of the process divided by the connection count is reported, client sockets don't use heap.
+// usage: IdleMemoryBench [count] [port]
+
+static size_t HeapBytes() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    struct mallinfo info = mallinfo();
+    return (size_t)(unsigned)info.uordblks + (size_t)(unsigned)info.hblkhd;
+#endif
+}
+
+static size_t ResidentBytes() {
+    size_t pages = 0, resident = 0;
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file == nullptr)
+        return 0;
+    if (fscanf(file, "%zu %zu", &pages, &resident) != 2)
+        resident = 0;
+    fclose(file);
+    return resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static bool WaitFor(const std::atomic_size_t& value, const size_t target) {
+    for (int i = 0; i < 1000 && value.load() < target; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return value.load() >= target;
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? (size_t)atoi(argv[1]) : 5000;
+    const int port = argc > 2 ? atoi(argv[2]) : 18080;
+
+    // both ends of every connection live in this process
+    rlimit limit{};
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    if (count > (limit.rlim_cur - 64) / 2)
+        count = (limit.rlim_cur - 64) / 2;
+
+    std::atomic_size_t connected(0);
+    std::atomic_size_t replied(0);
+
+    Core core;
+    EndpointPtr endpoint = Endpoint::CreateEndpoint(&core, port,
+        [&connected](const ConnectionPtr&) {
+            connected++;
+        },
+        [&replied](const ConnectionPtr& conn) {
+            conn->ReadStrings("\r\n", [&conn, &replied](const BufferView&) {
+                conn->MsgEnqueue("pong\r\n", 6);
+                replied++;
+            });
+        },
+        [](const ConnectionPtr&) {}
+    );
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    // reserve client side storage first, it is not counted
+    std::vector<int> clients;
+    clients.reserve(count);
+
+    const size_t heap_before = HeapBytes();
+    const size_t rss_before = ResidentBytes();
+
+    for (size_t i = 0; i < count; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+            std::cerr << "IdleMemoryBench >> connect failed after " << i << " connections" << std::endl;
+            if (fd >= 0)
+                close(fd);
+            break;
+        }
+        clients.push_back(fd);
+
+        // don't overflow the accept queue of the endpoint, its backlog is SOMAXCONN
+        if (clients.size() % 1024 == 0)
+            WaitFor(connected, clients.size());
+    }
+    count = clients.size();
+
+    if (!WaitFor(connected, count)) {
+        std::cerr << "IdleMemoryBench >> only " << connected.load() << " of " << count << " connections accepted" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // one heartbeat each, then everything goes idle
+    char reply[16];
+    for (size_t i = 0; i < count; i++)
+        send(clients[i], "ping\r\n", 6, MSG_NOSIGNAL);
+    for (size_t i = 0; i < count; i++)
+        recv(clients[i], reply, sizeof(reply), 0);
+    WaitFor(replied, count);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    const size_t heap_after = HeapBytes();
+    const size_t rss_after = ResidentBytes();
+
+    std::printf("connections:              %zu\n", count);
+    std::printf("heap per idle connection: %zu bytes\n", (heap_after - heap_before) / (count > 0 ? count : 1));
+    std::printf("rss per idle connection:  %zu bytes\n", (rss_after - rss_before) / (count > 0 ? count : 1));
+
+    for (size_t i = 0; i < clients.size(); i++)
+        close(clients[i]);
+    endpoint->CloseEndpoint();
+    endpoint.reset();
+
+    return 0;
+}
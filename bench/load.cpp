@@ -0,0 +1,278 @@
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+#include <SafetyTcpConn/SafetyTcpConn.hpp>
+
+using namespace SafetyTcpConn;
+
+// Loopback echo load.
+// For every connection count, the connections ping-pong one message at a time for `seconds`,
+// throughput and echo latency percentiles are reported. Server and clients run in this process.
+// usage: LoadBench [seconds] [port] [reactors] [connection counts...]
+
+static const size_t kMsgSize    = 32;   // including "\r\n"
+static const int    kSourceIps  = 16;   // clients bind to 127.0.0.1 ~ 127.0.0.16, so 50k connections don't run out of ports
+
+typedef std::chrono::steady_clock Clock;
+
+static uint64_t NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static bool WaitFor(const std::atomic_size_t& value, const size_t target, const int timeout_ms) {
+    for (int i = 0; i < timeout_ms * 10 && value.load() < target; i++)
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    return value.load() >= target;
+}
+
+static size_t RaiseFdLimit() {
+    rlimit limit{};
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    return limit.rlim_cur;
+}
+
+// one client thread, owns a part of the connections and its own epoll
+class ClientGroup {
+public:
+    std::vector<int>        m_fds_;
+    std::vector<uint64_t>   m_sent_us_;     // send time of the message in flight
+    std::vector<size_t>     m_got_;         // bytes of the echo received so far
+    std::vector<uint32_t>   m_latencies_us_;
+    uint64_t                m_errors_;
+
+    ClientGroup() : m_errors_(0) {};
+
+    void Run(const uint64_t end_us) {
+        const int epoll_fd = epoll_create(1);
+        for (size_t i = 0; i < m_fds_.size(); i++) {
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.u64 = i;
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, m_fds_[i], &event);
+        }
+
+        m_sent_us_.assign(m_fds_.size(), 0);
+        m_got_.assign(m_fds_.size(), 0);
+
+        char msg[kMsgSize];
+        std::memset(msg, 'x', kMsgSize - 2);
+        msg[kMsgSize - 2] = '\r';
+        msg[kMsgSize - 1] = '\n';
+
+        // one message in flight for every connection
+        size_t in_flight = 0;
+        for (size_t i = 0; i < m_fds_.size(); i++) {
+            m_sent_us_[i] = NowUs();
+            if (send(m_fds_[i], msg, kMsgSize, MSG_NOSIGNAL) == (ssize_t)kMsgSize)
+                in_flight++;
+            else
+                m_errors_++;
+        }
+
+        const int kMaxEvents = 256;
+        epoll_event events[kMaxEvents];
+        char buff[4096];
+        // after the end, wait a while for the messages in flight
+        const uint64_t drain_end_us = end_us + 2000000;
+
+        while (in_flight > 0) {
+            const uint64_t now = NowUs();
+            if (now >= drain_end_us)
+                break;
+
+            const int count = epoll_wait(epoll_fd, events, kMaxEvents, 10);
+            for (int e = 0; e < count; e++) {
+                const size_t i = events[e].data.u64;
+                ssize_t ret = recv(m_fds_[i], buff, sizeof(buff), 0);
+                if (ret <= 0) {
+                    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, m_fds_[i], nullptr);
+                    m_errors_++;
+                    in_flight--;
+                    continue;
+                }
+
+                m_got_[i] += ret;
+                if (m_got_[i] < kMsgSize)
+                    continue;
+
+                const uint64_t recv_us = NowUs();
+                m_latencies_us_.push_back((uint32_t)(recv_us - m_sent_us_[i]));
+                m_got_[i] = 0;
+
+                // next round trip
+                if (recv_us < end_us) {
+                    m_sent_us_[i] = recv_us;
+                    if (send(m_fds_[i], msg, kMsgSize, MSG_NOSIGNAL) != (ssize_t)kMsgSize) {
+                        m_errors_++;
+                        in_flight--;
+                    }
+                }
+                else {
+                    in_flight--;
+                }
+            }
+        }
+
+        close(epoll_fd);
+    }
+};
+
+static void RunLevel(const size_t count, const int port, const double seconds, const size_t client_threads, std::atomic_size_t& connected) {
+    // open connections, paced so the accept queue of the endpoint never overflows
+    std::vector<int> fds;
+    fds.reserve(count);
+    const size_t connected_before = connected.load();
+
+    for (size_t i = 0; i < count; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0)
+            break;
+
+        // spread across source addresses, each one has its own port range
+        sockaddr_in local{};
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_LOOPBACK + (uint32_t)(i % kSourceIps));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        if (bind(fd, (sockaddr*)&local, sizeof(local)) < 0 || connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+            close(fd);
+            break;
+        }
+
+        // close with RST, so the next level doesn't meet ports in TIME_WAIT
+        linger lin{};
+        lin.l_onoff = 1;
+        lin.l_linger = 0;
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &lin, sizeof(lin));
+
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+        fds.push_back(fd);
+        if (fds.size() % 1024 == 0)
+            WaitFor(connected, connected_before + fds.size(), 1000);
+    }
+
+    if (fds.size() < count)
+        std::cerr << "LoadBench >> only " << fds.size() << " of " << count << " connections opened" << std::endl;
+    if (fds.empty() || !WaitFor(connected, connected_before + fds.size(), 10000)) {
+        std::cerr << "LoadBench >> connections are not accepted" << std::endl;
+        for (size_t i = 0; i < fds.size(); i++)
+            close(fds[i]);
+        return;
+    }
+
+    // split connections across client threads
+    const size_t group_count = std::min(client_threads, fds.size());
+    std::vector<ClientGroup> groups(group_count);
+    for (size_t i = 0; i < fds.size(); i++)
+        groups[i % group_count].m_fds_.push_back(fds[i]);
+
+    const uint64_t start_us = NowUs();
+    const uint64_t end_us = start_us + (uint64_t)(seconds * 1000000);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < group_count; i++)
+        threads.emplace_back(&ClientGroup::Run, &groups[i], end_us);
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+
+    // merge and report
+    std::vector<uint32_t> latencies;
+    uint64_t errors = 0;
+    for (size_t i = 0; i < groups.size(); i++) {
+        latencies.insert(latencies.end(), groups[i].m_latencies_us_.begin(), groups[i].m_latencies_us_.end());
+        errors += groups[i].m_errors_;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    auto percentile = [&latencies](const double quantile) -> uint32_t {
+        if (latencies.empty())
+            return 0;
+        size_t index = (size_t)(quantile * latencies.size());
+        if (index >= latencies.size())
+            index = latencies.size() - 1;
+        return latencies[index];
+    };
+
+    std::printf("%8zu conns %12.0f msg/s   p50 %8u us   p99 %8u us   p999 %8u us   errors %llu\n",
+        fds.size(), latencies.size() / seconds, percentile(0.5), percentile(0.99), percentile(0.999), (unsigned long long)errors);
+
+    for (size_t i = 0; i < fds.size(); i++)
+        close(fds[i]);
+}
+
+int main(int argc, char** argv) {
+    const double seconds = argc > 1 ? atof(argv[1]) : 3;
+    const int port = argc > 2 ? atoi(argv[2]) : 18081;
+    size_t reactors = argc > 3 ? (size_t)atoi(argv[3]) : 0;
+
+    std::vector<size_t> counts;
+    for (int i = 4; i < argc; i++)
+        counts.push_back((size_t)atoi(argv[i]));
+    if (counts.empty())
+        counts = { 1, 1000, 50000 };
+
+    // half of the cores serve, the other half load
+    const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    if (reactors == 0)
+        reactors = std::max((size_t)1, cores / 2);
+    const size_t client_threads = std::max((size_t)1, cores - reactors);
+
+    // both ends of every connection live in this process
+    const size_t max_count = (RaiseFdLimit() - 64) / 2;
+
+    std::atomic_size_t connected(0);
+
+    // one message in flight per connection, a corked socket would hold every echo for 200 ms
+    Core core(reactors);
+    EndpointPtr endpoint = Endpoint::CreateEndpoint(&core, port,
+        [&connected](const ConnectionPtr&) {
+            connected++;
+        },
+        [](const ConnectionPtr& conn) {
+            conn->ReadStrings("\r\n", [&conn](const BufferView& msg) {
+                conn->MsgEnqueue(msg.Data(), msg.Size());
+                conn->MsgEnqueue("\r\n", 2);
+            });
+        },
+        [](const ConnectionPtr&) {},
+        TransportPolicy::LowLatency()
+    );
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::printf("reactors: %zu, client threads: %zu, message: %zu bytes, %.1f s per level\n", reactors, client_threads, kMsgSize, seconds);
+    for (size_t i = 0; i < counts.size(); i++) {
+        size_t count = counts[i];
+        if (count > max_count) {
+            std::cerr << "LoadBench >> " << count << " connections need more fds, limited to " << max_count << std::endl;
+            count = max_count;
+        }
+
+        RunLevel(count, port, seconds, client_threads, connected);
+
+        // let the server clean up the closed connections
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+
+    endpoint->CloseEndpoint();
+    endpoint.reset();
+
+    return 0;
+}
\ No newline at end of file
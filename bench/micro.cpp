@@ -0,0 +1,257 @@
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#include <arpa/inet.h>
+
+#include <SafetyTcpConn/SafetyTcpConn.hpp>
+
+using namespace SafetyTcpConn;
+
+// Microbenchmarks of the hot paths of a connection.
+// A loopback client feeds a real connection, only the library calls are timed, waiting for the network is not.
+// usage: MicroBench [rounds] [port]
+
+static const size_t kMsgSize        = 32;       // including "\r\n"
+static const size_t kBatchCount     = 4096;     // messages in one batch, 128 KB, far below the max buffer size
+static const size_t kBatchBytes     = kMsgSize * kBatchCount;
+
+typedef std::chrono::steady_clock Clock;
+
+static uint64_t ElapsedNs(const Clock::time_point& start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+static void Report(const char* name, const uint64_t ops, const uint64_t ns) {
+    std::printf("%-34s %12llu ops %10.1f ns/op %10.2f Mops/s\n", name, (unsigned long long)ops,
+        ops == 0 ? 0.0 : (double)ns / ops, ns == 0 ? 0.0 : ops * 1000.0 / ns);
+}
+
+static void ReportBytes(const char* name, const uint64_t bytes, const uint64_t ns) {
+    std::printf("%-34s %12llu bytes %8.1f MB/s\n", name, (unsigned long long)bytes, ns == 0 ? 0.0 : bytes * 1000.0 / ns);
+}
+
+static bool WaitFor(const std::atomic_size_t& value, const size_t target) {
+    for (int i = 0; i < 100000 && value.load() < target; i++)
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    return value.load() >= target;
+}
+
+static bool SendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t ret = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (ret <= 0)
+            return false;
+        sent += ret;
+    }
+    return true;
+}
+
+// growing a recv buffer from empty to its max size, then draining it, which releases the block
+static void BenchBufferGrowth(const size_t rounds) {
+    const size_t chunk = 1500;
+    const size_t max_size = 65536 * 16;
+    char data[chunk] = {};
+
+    uint64_t appends = 0;
+    const uint64_t growths_before = Metrics::Snapshot().Get(MetricCounter::kBufferGrowths);
+
+    Buffer buffer(16384, max_size);
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < rounds; i++) {
+        while (buffer.Size() + chunk <= max_size && buffer.Append(data, chunk))
+            appends++;
+        buffer.Consume(buffer.Size());
+    }
+    const uint64_t ns = ElapsedNs(start);
+    const uint64_t growths = Metrics::Snapshot().Get(MetricCounter::kBufferGrowths) - growths_before;
+
+    Report("Buffer::Append (1500 B)", appends, ns);
+    if (growths > 0)
+        std::printf("%-34s %12llu growths, %.1f appends per growth\n", "  ExtendBuffer (Buffer::Reserve)", (unsigned long long)growths, (double)appends / growths);
+}
+
+int main(int argc, char** argv) {
+    const size_t rounds = argc > 1 ? (size_t)atoi(argv[1]) : 50;
+    const int port = argc > 2 ? atoi(argv[2]) : 18082;
+
+    BenchBufferGrowth(rounds);
+
+    std::mutex mtx_conn;
+    ConnectionPtr server_conn;
+    std::atomic_size_t received(0);
+
+    // the process function only reports how much is buffered, the benchmark thread reads
+    Core core;
+    EndpointPtr endpoint = Endpoint::CreateEndpoint(&core, port,
+        [&mtx_conn, &server_conn](const ConnectionPtr& conn) {
+            std::unique_lock<std::mutex> lck(mtx_conn);
+            server_conn = conn;
+        },
+        [&received](const ConnectionPtr& conn) {
+            received.store(conn->Peek().Size());
+        },
+        [](const ConnectionPtr&) {}
+    );
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int client = socket(AF_INET, SOCK_STREAM, 0);
+    if (client < 0 || connect(client, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        std::cerr << "MicroBench >> connect failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    ConnectionPtr conn;
+    for (int i = 0; i < 1000 && conn == nullptr; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::unique_lock<std::mutex> lck(mtx_conn);
+        conn = server_conn;
+    }
+    if (conn == nullptr) {
+        std::cerr << "MicroBench >> connection not accepted" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // one batch of "xxx...x\r\n" messages
+    std::string batch;
+    for (size_t i = 0; i < kBatchCount; i++) {
+        batch.append(kMsgSize - 2, 'x');
+        batch.append("\r\n");
+    }
+
+    // read methods, each batch is fully received before reading starts
+    const char* read_names[] = { "Connection::ReadString", "Connection::ReadStrings (in place)", "Connection::ReadBytes", "Connection::ReadBytes (in place)" };
+    for (int method = 0; method < 4; method++) {
+        uint64_t ops = 0;
+        uint64_t ns = 0;
+
+        for (size_t i = 0; i < rounds; i++) {
+            received.store(0);
+            if (!SendAll(client, batch) || !WaitFor(received, kBatchBytes)) {
+                std::cerr << "MicroBench >> feeding the connection failed" << std::endl;
+                return EXIT_FAILURE;
+            }
+
+            Clock::time_point start = Clock::now();
+            size_t count = 0;
+            switch (method) {
+                case 0: {
+                    bool keep_read = true;
+                    while (keep_read) {
+                        std::string msg = conn->ReadString("\r\n", keep_read);
+                        if (!msg.empty())
+                            count++;
+                    }
+                    break;
+                }
+                case 1:
+                    count = conn->ReadStrings("\r\n", [](const BufferView&) {});
+                    break;
+                case 2:
+                    for (size_t j = 0; j < kBatchCount; j++) {
+                        char* msg = conn->ReadBytes(kMsgSize);
+                        if (msg == nullptr)
+                            break;
+                        delete [] msg;
+                        count++;
+                    }
+                    break;
+                default:
+                    while (count < kBatchCount && conn->ReadBytes(kMsgSize, [](const BufferView&) {}))
+                        count++;
+                    break;
+            }
+            ns += ElapsedNs(start);
+            ops += count;
+        }
+
+        Report(read_names[method], ops, ns);
+    }
+
+    // the client drains everything the connection sends from here on
+    std::atomic_bool draining(true);
+    std::atomic_size_t drained(0);
+    std::thread drainer([client, &draining, &drained]() {
+        std::vector<char> buff(65536);
+        while (draining.load()) {
+            ssize_t ret = recv(client, buff.data(), buff.size(), 0);
+            if (ret <= 0)
+                break;
+            drained.fetch_add(ret);
+        }
+    });
+
+    // MsgEnqueue of small messages, one batch at a time so the send buffer never reaches its max size
+    {
+        const char msg[kMsgSize] = {};
+        uint64_t ops = 0;
+        uint64_t ns = 0;
+        size_t target = drained.load();
+
+        for (size_t i = 0; i < rounds; i++) {
+            Clock::time_point start = Clock::now();
+            for (size_t j = 0; j < kBatchCount; j++)
+                conn->MsgEnqueue(msg, kMsgSize);
+            ns += ElapsedNs(start);
+            ops += kBatchCount;
+
+            target += kBatchBytes;
+            if (!WaitFor(drained, target)) {
+                std::cerr << "MicroBench >> messages are not sent" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        Report("Connection::MsgEnqueue (32 B)", ops, ns);
+    }
+
+    // send path, from enqueue of 16 KB messages until the client has them, TrySend writes them with sendmsg
+    {
+        const std::string msg(16384, 'y');
+        const size_t msgs_per_round = 32;
+        uint64_t bytes = 0;
+        size_t target = drained.load();
+
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < rounds; i++) {
+            for (size_t j = 0; j < msgs_per_round; j++)
+                conn->MsgEnqueue(msg);
+
+            target += msg.size() * msgs_per_round;
+            if (!WaitFor(drained, target)) {
+                std::cerr << "MicroBench >> messages are not sent" << std::endl;
+                return EXIT_FAILURE;
+            }
+            bytes += msg.size() * msgs_per_round;
+        }
+
+        ReportBytes("Connection::TrySend (16 KB msgs)", bytes, ElapsedNs(start));
+    }
+
+    draining.store(false);
+    shutdown(client, SHUT_RDWR);
+    drainer.join();
+    close(client);
+
+    conn.reset();
+    {
+        std::unique_lock<std::mutex> lck(mtx_conn);
+        server_conn.reset();
+    }
+    endpoint->CloseEndpoint();
+    endpoint.reset();
+
+    return 0;
+}
\ No newline at end of file
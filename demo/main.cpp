@@ -6,14 +6,15 @@
 using namespace SafetyTcpConn;
 
 int main(int, char**) {
+    // pass the number of reactors to spread connections across cores, e.g. Core core(4);
     Core core;
 
     EndpointPtr endpoint = Endpoint::CreateEndpoint(&core, 8080,
-        [](ConnectionPtr conn) {
+        [](const ConnectionPtr& conn) {
             std::cout << "SafetyTcpConnDemo >> Main >> Client Connected | FD:" << conn->m_fd_ << std::endl;
             // you can store the ConnectionPtr to your own data structure
         },
-        [](ConnectionPtr conn) {
+        [](const ConnectionPtr& conn) {
             std::cout << "SafetyTcpConnDemo >> Main >> Message Come | FD:" << conn->m_fd_ << std::endl;
 
             bool keep_read = true;
@@ -28,7 +29,7 @@ int main(int, char**) {
                 conn->MsgEnqueue(fullMsg.c_str(), fullMsg.size());
             }
         },
-        [](ConnectionPtr conn) {
+        [](const ConnectionPtr& conn) {
             std::cout << "SafetyTcpConnDemo >> Main >> Client Disconnected | FD:" << conn->m_fd_ << std::endl;
             // remove the ConnectionPtr from your own data structure
         }
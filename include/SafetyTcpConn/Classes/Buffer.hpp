@@ -0,0 +1,94 @@
+#ifndef STC_BUFFER_HPP
+#define STC_BUFFER_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include "Classes.hpp"
+#include "BufferPool.hpp"
+#include "Metrics.hpp"
+
+namespace SafetyTcpConn {
+
+/// @brief A borrowed view of bytes, it doesn't own the memory it points to.
+class BufferView {
+private:
+    const char* m_data_;
+    size_t      m_size_;
+public:
+    BufferView() : m_data_(nullptr), m_size_(0) {};
+    BufferView(const char* data, size_t size) : m_data_(data), m_size_(size) {};
+
+    const char* Data() const { return m_data_; };
+    size_t Size() const { return m_size_; };
+    bool Empty() const { return m_size_ == 0; };
+
+    const char& operator[](size_t index) const { return m_data_[index]; };
+
+    /// @brief Copy the viewed bytes into a `std::string`
+    std::string ToString() const { return std::string(m_data_, m_size_); };
+};
+
+/// @brief A byte buffer with read/write cursors.
+/// @note Reading only moves the read cursor, so consuming a message costs O(message) instead of O(buffer).
+/// Readable bytes are always contiguous and are moved to the front only when the free space at the tail is not enough
+/// and the consumed space at the front is at least as large as the readable bytes, which keeps the moving cost amortized O(1) per byte.
+/// Storage comes from `BufferPool` only when bytes are written, it grows by doubling and goes back to the pool once everything is read,
+/// so an idle buffer holds no memory.
+class Buffer {
+private:
+    char*   m_data_;
+    size_t  m_capacity_;
+    size_t  m_read_idx_;
+    size_t  m_write_idx_;
+
+    const size_t m_init_size_;
+    const size_t m_max_size_;
+public:
+    Buffer(size_t init_size, size_t max_size);
+    ~Buffer();
+
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    /// @brief Get the count of readable bytes
+    size_t Size() const;
+
+    /// @brief Get the allocated size
+    size_t Capacity() const;
+
+    /// @brief Get the pointer to the first readable byte
+    const char* Data() const;
+
+    /// @brief Mark `len` readable bytes as read, the storage goes back to the pool when everything is read
+    void Consume(size_t len);
+
+    /// @brief Give the storage back to the pool if nothing is readable
+    void Trim();
+
+    /// @brief Make sure there are at least `len` bytes writable after `WriteData()`, storage of at least the initial size is allocated on first use
+    /// @return `bool`: space ready(`true`) / reach max buffer size(`false`)
+    bool Reserve(size_t len);
+
+    /// @brief Get the pointer to the first writable byte, call `Reserve` before writing
+    char* WriteData();
+
+    /// @brief Get the count of writable bytes at the tail
+    size_t Writable() const;
+
+    /// @brief Mark `len` bytes after `WriteData()` as readable
+    void Commit(size_t len);
+
+    /// @brief Copy `len` bytes to the end of readable bytes
+    /// @return `bool`: appended(`true`) / reach max buffer size(`false`)
+    bool Append(const char* data, size_t len);
+
+    /// @brief Exchange the storage and cursors with `other`, nothing is copied
+    void Swap(Buffer& other);
+};
+
+}
+
+#endif
\ No newline at end of file
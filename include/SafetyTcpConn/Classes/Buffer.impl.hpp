@@ -0,0 +1,140 @@
+#ifndef STC_BUFFER_FUNC_HPP
+#define STC_BUFFER_FUNC_HPP
+
+#include "Buffer.hpp"
+
+namespace SafetyTcpConn {
+
+Buffer::Buffer(size_t init_size, size_t max_size) :
+    m_data_(nullptr), m_capacity_(0), m_read_idx_(0), m_write_idx_(0),
+    m_init_size_(init_size), m_max_size_(max_size)
+{
+}
+
+Buffer::~Buffer() {
+    BufferPool::Instance().Release(m_data_, m_capacity_);
+}
+
+inline size_t Buffer::Size() const {
+    return m_write_idx_ - m_read_idx_;
+}
+
+inline size_t Buffer::Capacity() const {
+    return m_capacity_;
+}
+
+inline const char* Buffer::Data() const {
+    return m_data_ + m_read_idx_;
+}
+
+inline void Buffer::Consume(size_t len) {
+    if (len >= Size()) {
+        // everything is read, rewind both cursors and give the block back to the pool
+        m_read_idx_ = 0;
+        m_write_idx_ = 0;
+        Trim();
+        return;
+    }
+
+    m_read_idx_ += len;
+}
+
+inline void Buffer::Trim() {
+    if (m_data_ == nullptr || Size() > 0)
+        return;
+
+    BufferPool::Instance().Release(m_data_, m_capacity_);
+    m_data_ = nullptr;
+    m_capacity_ = 0;
+    m_read_idx_ = 0;
+    m_write_idx_ = 0;
+}
+
+inline bool Buffer::Reserve(size_t len) {
+    // enough space at the tail
+    if (m_capacity_ - m_write_idx_ >= len)
+        return true;
+
+    const size_t size = Size();
+    const size_t future_size = size + len;
+
+    // move readable bytes to the front when it is cheap enough, only the consumed space is needed
+    if (future_size <= m_capacity_ && m_read_idx_ >= size) {
+        std::memmove(m_data_, m_data_ + m_read_idx_, size);
+        m_read_idx_ = 0;
+        m_write_idx_ = size;
+        return true;
+    }
+
+    // grow geometrically, at least double the capacity, but never over max size
+    size_t target_capacity = BufferPool::BlockSize(future_size);
+    if (target_capacity < m_capacity_ * 2)
+        target_capacity = m_capacity_ * 2;
+    if (target_capacity < m_init_size_)
+        target_capacity = m_init_size_;
+    if (target_capacity > m_max_size_)
+        target_capacity = m_max_size_;
+
+    // reach max allocation size
+    if (target_capacity <= m_capacity_ || future_size > target_capacity) {
+        if (future_size > m_capacity_)
+            return false;
+
+        // can't grow any more, move readable bytes to the front anyway
+        std::memmove(m_data_, m_data_ + m_read_idx_, size);
+        m_read_idx_ = 0;
+        m_write_idx_ = size;
+        return true;
+    }
+
+    // allocate buff and copy readable bytes to the front of it
+    BufferPool& pool = BufferPool::Instance();
+    size_t new_capacity = 0;
+    char* new_data = pool.Allocate(target_capacity, new_capacity);
+    if (size > 0)
+        std::memcpy(new_data, m_data_ + m_read_idx_, size);
+
+    // the first block of an empty buffer is not a growth
+    if (m_data_ != nullptr)
+        Metrics::Add(MetricCounter::kBufferGrowths);
+
+    pool.Release(m_data_, m_capacity_);
+    m_data_ = new_data;
+    m_capacity_ = new_capacity;
+    m_read_idx_ = 0;
+    m_write_idx_ = size;
+
+    return true;
+}
+
+inline char* Buffer::WriteData() {
+    return m_data_ + m_write_idx_;
+}
+
+inline size_t Buffer::Writable() const {
+    return m_capacity_ - m_write_idx_;
+}
+
+inline void Buffer::Commit(size_t len) {
+    m_write_idx_ += len;
+}
+
+inline bool Buffer::Append(const char* data, size_t len) {
+    if (!Reserve(len))
+        return false;
+
+    std::memcpy(m_data_ + m_write_idx_, data, len);
+    m_write_idx_ += len;
+    return true;
+}
+
+inline void Buffer::Swap(Buffer& other) {
+    std::swap(m_data_, other.m_data_);
+    std::swap(m_capacity_, other.m_capacity_);
+    std::swap(m_read_idx_, other.m_read_idx_);
+    std::swap(m_write_idx_, other.m_write_idx_);
+}
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,84 @@
+#ifndef STC_BUFFER_POOL_HPP
+#define STC_BUFFER_POOL_HPP
+
+#include <cstddef>
+#include <mutex>
+
+#include "Classes.hpp"
+
+namespace SafetyTcpConn {
+
+/// @brief Size-classed pool of byte blocks for recv and send buffers.
+/// @note Classes are powers of 2 from `kMinClassSize` to `kMaxClassSize`. Each thread keeps a few free blocks per class without locking,
+/// the rest go to the shared free lists, which only keep up to `kMaxPooledBytes` per class and give the others back to the system.
+/// Blocks larger than `kMaxClassSize` are not pooled.
+class BufferPool {
+public:
+    static constexpr size_t kMinClassBits   = 12;
+    static constexpr size_t kMinClassSize   = (size_t)1 << kMinClassBits;   // 4 KB
+    static constexpr int    kClassCount     = 9;                            // up to 1 MB
+    static constexpr size_t kMaxClassSize   = kMinClassSize << (kClassCount - 1);
+
+    static constexpr size_t kThreadCacheCount   = 8;
+    static constexpr size_t kMaxPooledBytes     = 16 * 1024 * 1024;
+private:
+    // free blocks are linked through their own memory
+    struct FreeBlock {
+        FreeBlock* m_next_;
+    };
+
+    // free blocks kept by one thread, returned to the shared pool when the thread ends
+    class ThreadCache {
+    public:
+        FreeBlock*  m_free_[kClassCount];
+        size_t      m_free_count_[kClassCount];
+
+        ThreadCache();
+        ~ThreadCache();
+    };
+
+    std::mutex  m_mtx_[kClassCount];
+    FreeBlock*  m_free_[kClassCount];
+    size_t      m_free_count_[kClassCount];
+private:
+    BufferPool();
+
+public:
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    /// @brief Get the pool shared by the whole process
+    /// @note It is never destroyed, buffers can still be released while static objects are destroyed.
+    static BufferPool& Instance();
+
+    /// @brief Get the block size that `Allocate(size)` gives, the smallest class not smaller than `size`
+    static size_t BlockSize(const size_t size);
+
+    /// @brief Allocate a block of at least `size` bytes
+    /// @param capacity set to the real size of the block, pass it back to `Release`
+    char* Allocate(const size_t size, size_t& capacity);
+
+    /// @brief Give a block back to the pool
+    void Release(char* data, const size_t capacity);
+
+private:
+    /// @brief Get the class index of a block size / `-1` if it is not a class size
+    static int ClassIndex(const size_t capacity);
+
+    static ThreadCache& LocalCache();
+
+    /// @brief Get whether the cache of this thread is destroyed, blocks are then allocated and released through the shared free lists
+    static bool& CacheDestroyed();
+
+    /// @brief Move a chain of free blocks into the shared free list of class `index`, the blocks over `kMaxPooledBytes` are deleted
+    void Put(const int index, FreeBlock* head);
+
+    /// @brief Take up to `count` free blocks from the shared free list of class `index`
+    FreeBlock* Take(const int index, size_t& count);
+};
+
+}
+
+#endif
\ No newline at end of file
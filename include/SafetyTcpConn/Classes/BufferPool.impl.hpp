@@ -0,0 +1,190 @@
+#ifndef STC_BUFFER_POOL_FUNC_HPP
+#define STC_BUFFER_POOL_FUNC_HPP
+
+#include "BufferPool.hpp"
+
+namespace SafetyTcpConn {
+
+BufferPool::ThreadCache::ThreadCache() {
+    for (int i = 0; i < kClassCount; i++) {
+        m_free_[i] = nullptr;
+        m_free_count_[i] = 0;
+    }
+}
+
+BufferPool::ThreadCache::~ThreadCache() {
+    // static objects destroyed after it may still allocate and release on this thread
+    CacheDestroyed() = true;
+    for (int i = 0; i < kClassCount; i++) {
+        if (m_free_[i] != nullptr)
+            BufferPool::Instance().Put(i, m_free_[i]);
+        m_free_[i] = nullptr;
+        m_free_count_[i] = 0;
+    }
+}
+
+BufferPool::BufferPool() {
+    for (int i = 0; i < kClassCount; i++) {
+        m_free_[i] = nullptr;
+        m_free_count_[i] = 0;
+    }
+}
+
+BufferPool::~BufferPool() {
+    for (int i = 0; i < kClassCount; i++) {
+        FreeBlock* block = m_free_[i];
+        while (block != nullptr) {
+            FreeBlock* next = block->m_next_;
+            delete [] reinterpret_cast<char*>(block);
+            block = next;
+        }
+    }
+}
+
+inline BufferPool& BufferPool::Instance() {
+    static BufferPool* pool = new BufferPool();
+    return *pool;
+}
+
+inline size_t BufferPool::BlockSize(const size_t size) {
+    if (size > kMaxClassSize)
+        return size;
+
+    size_t block_size = kMinClassSize;
+    while (block_size < size)
+        block_size <<= 1;
+    return block_size;
+}
+
+inline char* BufferPool::Allocate(const size_t size, size_t& capacity) {
+    capacity = BlockSize(size);
+
+    const int index = ClassIndex(capacity);
+    if (index < 0)
+        return new char[capacity];
+
+    if (CacheDestroyed()) {
+        size_t count = 1;
+        FreeBlock* block = Take(index, count);
+        return block != nullptr ? reinterpret_cast<char*>(block) : new char[capacity];
+    }
+
+    // lock-free hit in the cache of this thread
+    ThreadCache& cache = LocalCache();
+    if (cache.m_free_[index] == nullptr) {
+        // refill half of the cache from the shared free list
+        size_t count = kThreadCacheCount / 2;
+        cache.m_free_[index] = Take(index, count);
+        cache.m_free_count_[index] = count;
+    }
+
+    FreeBlock* block = cache.m_free_[index];
+    if (block == nullptr)
+        return new char[capacity];
+
+    cache.m_free_[index] = block->m_next_;
+    cache.m_free_count_[index]--;
+    return reinterpret_cast<char*>(block);
+}
+
+inline void BufferPool::Release(char* data, const size_t capacity) {
+    if (data == nullptr)
+        return;
+
+    const int index = ClassIndex(capacity);
+    if (index < 0) {
+        delete [] data;
+        return;
+    }
+
+    FreeBlock* block = reinterpret_cast<FreeBlock*>(data);
+    if (CacheDestroyed()) {
+        block->m_next_ = nullptr;
+        Put(index, block);
+        return;
+    }
+
+    ThreadCache& cache = LocalCache();
+    block->m_next_ = cache.m_free_[index];
+    cache.m_free_[index] = block;
+    cache.m_free_count_[index]++;
+
+    // cache is full, move half of it to the shared free list
+    if (cache.m_free_count_[index] > kThreadCacheCount) {
+        FreeBlock* head = cache.m_free_[index];
+        FreeBlock* tail = head;
+        const size_t count = kThreadCacheCount / 2;
+        for (size_t i = 1; i < count; i++)
+            tail = tail->m_next_;
+
+        cache.m_free_[index] = tail->m_next_;
+        cache.m_free_count_[index] -= count;
+        tail->m_next_ = nullptr;
+        Put(index, head);
+    }
+}
+
+inline int BufferPool::ClassIndex(const size_t capacity) {
+    if (capacity < kMinClassSize || capacity > kMaxClassSize || (capacity & (capacity - 1)) != 0)
+        return -1;
+
+    int index = 0;
+    while ((kMinClassSize << index) < capacity)
+        index++;
+    return index;
+}
+
+inline BufferPool::ThreadCache& BufferPool::LocalCache() {
+    static thread_local ThreadCache cache;
+    return cache;
+}
+
+inline bool& BufferPool::CacheDestroyed() {
+    // trivially destructible, still readable after the cache is destroyed
+    static thread_local bool destroyed = false;
+    return destroyed;
+}
+
+inline void BufferPool::Put(const int index, FreeBlock* head) {
+    const size_t max_count = kMaxPooledBytes / (kMinClassSize << index);
+
+    std::unique_lock<std::mutex> lck(m_mtx_[index]);
+    while (head != nullptr) {
+        FreeBlock* next = head->m_next_;
+
+        // enough blocks are kept already, give the rest back to the system
+        if (m_free_count_[index] >= max_count) {
+            delete [] reinterpret_cast<char*>(head);
+        }
+        else {
+            head->m_next_ = m_free_[index];
+            m_free_[index] = head;
+            m_free_count_[index]++;
+        }
+
+        head = next;
+    }
+}
+
+inline BufferPool::FreeBlock* BufferPool::Take(const int index, size_t& count) {
+    std::unique_lock<std::mutex> lck(m_mtx_[index]);
+
+    FreeBlock* head = nullptr;
+    size_t taken = 0;
+    while (taken < count && m_free_[index] != nullptr) {
+        FreeBlock* block = m_free_[index];
+        m_free_[index] = block->m_next_;
+        m_free_count_[index]--;
+
+        block->m_next_ = head;
+        head = block;
+        taken++;
+    }
+
+    count = taken;
+    return head;
+}
+
+}
+
+#endif
\ No newline at end of file
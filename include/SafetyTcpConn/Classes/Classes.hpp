@@ -1,18 +1,34 @@
 #ifndef STC_CLASSES_HPP
 #define STC_CLASSES_HPP
 
+#include <functional>
 #include <memory>
+#include <string>
 
 namespace SafetyTcpConn {
 
 class Core;
+class Reactor;
+class WorkerPool;
 class Container;
 class Endpoint;
 class Connection;
+class EndpointFuncs;
+class TransportPolicy;
+class ConnectionPool;
 
 typedef std::shared_ptr<Container> ContainerPtr;
 typedef std::shared_ptr<Endpoint> EndpointPtr;
 typedef std::shared_ptr<Connection> ConnectionPtr;
+typedef std::shared_ptr<const EndpointFuncs> EndpointFuncsPtr;
+typedef std::shared_ptr<const TransportPolicy> TransportPolicyPtr;
+typedef std::shared_ptr<ConnectionPool> ConnectionPoolPtr;
+
+// function run on a connection event, the connection is only borrowed for the call, copy the pointer to keep it
+typedef std::function<void(const ConnectionPtr&)> ConnectionFunc;
+
+// immutable message which can be shared by the send buffers of many connections
+typedef std::shared_ptr<const std::string> MessagePtr;
 
 }
 
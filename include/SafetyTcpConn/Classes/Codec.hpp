@@ -0,0 +1,78 @@
+#ifndef STC_CODEC_HPP
+#define STC_CODEC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+#include "Classes.hpp"
+#include "Buffer.hpp"
+
+namespace SafetyTcpConn {
+
+/// @brief Base of framing codecs.
+/// @note A codec splits the front of recv buff into frames by `size_t Decode(const char* data, size_t size, BufferView& frame) const`,
+/// which returns the count of bytes used by one frame (header included), `kIncomplete` when more bytes are needed, or `kError` when the data is invalid.
+/// Codecs are chosen by template parameter, so `Decode` is inlined into the read loop of `Connection::ReadFrames`.
+class Codec {
+public:
+    static constexpr size_t kIncomplete = 0;
+    static constexpr size_t kError      = (size_t)-1;
+
+    /// @brief Default maximum frame size, same as the max size of recv buff
+    static constexpr size_t kDefaultMaxFrameSize = 65536 * 16;
+};
+
+enum class Endian {
+    kBig,
+    kLittle
+};
+
+/// @brief Frames end with a delimiter, the delimiter is not included in the frame.
+class DelimiterCodec : public Codec {
+private:
+    const std::string m_delimiter_;
+public:
+    DelimiterCodec(const std::string& delimiter) : m_delimiter_(delimiter) {};
+
+    const std::string& Delimiter() const { return m_delimiter_; };
+
+    size_t Decode(const char* data, const size_t size, BufferView& frame) const;
+};
+
+/// @brief Frames start with a fixed-width length header, the header is not included in the frame.
+/// @tparam LengthType unsigned integer type of the header. example: `uint16_t`, `uint32_t`
+/// @tparam kEndian byte order of the header
+/// @tparam kIncludeHeader whether the length in header counts the header itself
+/// @tparam kMaxFrameSize frames longer than this are treated as invalid
+template <typename LengthType, Endian kEndian = Endian::kBig, bool kIncludeHeader = false, size_t kMaxFrameSize = Codec::kDefaultMaxFrameSize>
+class LengthPrefixCodec : public Codec {
+    static_assert(std::is_integral<LengthType>::value && std::is_unsigned<LengthType>::value, "LengthType must be an unsigned integer");
+public:
+    static constexpr size_t kHeaderSize = sizeof(LengthType);
+
+    size_t Decode(const char* data, const size_t size, BufferView& frame) const;
+};
+
+/// @brief Frames start with a varint (LEB128, as protobuf) length header, the header is not included in the frame.
+/// @tparam kMaxFrameSize frames longer than this are treated as invalid
+template <size_t kMaxFrameSize = Codec::kDefaultMaxFrameSize>
+class VarintCodec : public Codec {
+public:
+    static constexpr size_t kMaxHeaderSize = 10;
+
+    size_t Decode(const char* data, const size_t size, BufferView& frame) const;
+};
+
+/// @brief Every frame has the same size.
+template <size_t kFrameSize>
+class FixedSizeCodec : public Codec {
+    static_assert(kFrameSize > 0, "kFrameSize must be larger than 0");
+public:
+    size_t Decode(const char* data, const size_t size, BufferView& frame) const;
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,86 @@
+#ifndef STC_CODEC_FUNC_HPP
+#define STC_CODEC_FUNC_HPP
+
+#include "Codec.hpp"
+#include "Scanner.hpp"
+
+namespace SafetyTcpConn {
+
+inline size_t DelimiterCodec::Decode(const char* data, const size_t size, BufferView& frame) const {
+    const size_t index = Scanner::Find(data, size, m_delimiter_.data(), m_delimiter_.size());
+    if (index == std::string::npos)
+        return kIncomplete;
+
+    frame = BufferView(data, index);
+    return index + m_delimiter_.size();
+}
+
+template <typename LengthType, Endian kEndian, bool kIncludeHeader, size_t kMaxFrameSize>
+inline size_t LengthPrefixCodec<LengthType, kEndian, kIncludeHeader, kMaxFrameSize>::Decode(const char* data, const size_t size, BufferView& frame) const {
+    if (size < kHeaderSize)
+        return kIncomplete;
+
+    // assemble the header byte by byte, no alignment or host byte order needed
+    const unsigned char* header = reinterpret_cast<const unsigned char*>(data);
+    uint64_t length = 0;
+    for (size_t i = 0; i < kHeaderSize; i++) {
+        const size_t shift = kEndian == Endian::kBig ? (kHeaderSize - 1 - i) * 8 : i * 8;
+        length |= (uint64_t)header[i] << shift;
+    }
+
+    if (kIncludeHeader) {
+        if (length < kHeaderSize)
+            return kError;
+        length -= kHeaderSize;
+    }
+
+    if (length > kMaxFrameSize)
+        return kError;
+
+    if (size - kHeaderSize < length)
+        return kIncomplete;
+
+    frame = BufferView(data + kHeaderSize, length);
+    return kHeaderSize + length;
+}
+
+template <size_t kMaxFrameSize>
+inline size_t VarintCodec<kMaxFrameSize>::Decode(const char* data, const size_t size, BufferView& frame) const {
+    const unsigned char* header = reinterpret_cast<const unsigned char*>(data);
+    uint64_t length = 0;
+
+    for (size_t i = 0; i < kMaxHeaderSize; i++) {
+        if (i >= size)
+            return kIncomplete;
+
+        length |= (uint64_t)(header[i] & 0x7F) << (7 * i);
+        if (length > kMaxFrameSize)
+            return kError;
+
+        // last byte of varint
+        if ((header[i] & 0x80) == 0) {
+            const size_t header_size = i + 1;
+            if (size - header_size < length)
+                return kIncomplete;
+
+            frame = BufferView(data + header_size, length);
+            return header_size + length;
+        }
+    }
+
+    // varint too long
+    return kError;
+}
+
+template <size_t kFrameSize>
+inline size_t FixedSizeCodec<kFrameSize>::Decode(const char* data, const size_t size, BufferView& frame) const {
+    if (size < kFrameSize)
+        return kIncomplete;
+
+    frame = BufferView(data, kFrameSize);
+    return kFrameSize;
+}
+
+}
+
+#endif
\ No newline at end of file
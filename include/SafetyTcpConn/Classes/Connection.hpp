@@ -8,53 +8,133 @@
 #include <cstring>
 
 #include <fcntl.h>
+#include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <sys/epoll.h>
 #include <unistd.h>
+#include <linux/errqueue.h>
+
+// older C libraries don't define them yet
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
 
 #include "Classes.hpp"
+#include "Metrics.hpp"
+#include "ObjectPool.hpp"
+#include "Buffer.hpp"
+#include "Scanner.hpp"
+#include "SendQueue.hpp"
+#include "TimerWheel.hpp"
+#include "Codec.hpp"
+#include "TransportPolicy.hpp"
 #include "Container.hpp"
 
 namespace SafetyTcpConn {
 
-class Connection : public Container {
+class Connection : public Container, public std::enable_shared_from_this<Connection> {
 private:
     friend class Core;
+    friend class Reactor;
     friend class Endpoint;
+    friend class WorkerPool;
+    friend class ConnectionPool;
     friend class std::shared_ptr<Connection>;
+    friend class PoolAllocator<Connection>;
+
+    static constexpr size_t kDefaultSize    = 16384;
+    static constexpr int    kMaxIovCount    = 64;
 
-    static constexpr size_t kDefaultSize = 16384;
-    static constexpr size_t kMaxSize     = 65536 * 16;
+    // for the adaptive transport policy
+    static constexpr size_t kMinSendChunk       = 16384;
+    static constexpr int    kMaxSendBuffer      = 4 * 1024 * 1024;
+    static constexpr int    kAdaptIntervalMs    = 100;
 private:
     std::atomic_bool    m_connected_;
+    std::atomic_bool    m_connecting_;      // outbound connection waiting for the connect to complete
+    std::atomic_bool    m_registered_;      // registered to its reactor, closing is posted to it from now on
+    std::atomic_bool    m_peer_closed_;     // the peer has finished sending, no more input comes
+    bool                m_fd_closed_;       // the fd is closed by `CloseFd`, guarded by `m_send_buff_mtx_`
+    bool                m_lingering_;       // `CloseFd` leaves the fd open until `FinishLinger`, guarded by `m_send_buff_mtx_`
     std::atomic_bool    m_send_flag_;
-    time_t              m_prev_sendtime_;
+
+    // for timeouts, times are in milliseconds of steady clock
+    std::atomic<uint32_t>   m_timeouts_[(int)TimeoutType::kCount];
+    std::atomic<uint64_t>   m_last_active_ms_;
+    std::atomic<uint64_t>   m_last_send_ms_;
+    std::atomic<uint64_t>   m_stall_since_ms_;
+    TimerNode               m_send_stall_timer_;
+    TimerNode               m_idle_timer_;
+    TimerNode               m_read_timer_;
+    TimerNode               m_connect_timer_;
+    bool                    m_timer_closed_;    // guarded by the timer mutex of reactor
+    std::atomic_bool        m_read_pending_;    // set by the thread running the process function
+
+    // for the strand of worker pool, count of requested process runs, the strand is queued or running while it is not 0
+    std::atomic<uint32_t>   m_strand_pending_;
+    std::atomic_bool        m_cleanup_pending_;
+
+    // for the send ready-list of reactor
+    std::atomic_bool    m_send_queued_;
+    ConnectionPtr       m_send_next_;
+
+    // for the io_uring backend, only used by the epoll thread
+    struct AsyncSend {
+        msghdr  m_msg_;
+        iovec   m_iov_[kMaxIovCount];
+    };
+    std::unique_ptr<AsyncSend>  m_uring_send_;      // created on the first async send
+    int                         m_uring_inflight_;  // count of operations in flight
+    bool                        m_uring_sending_;
 
     Core*                   m_core_;
     std::weak_ptr<Endpoint> m_endpoint_;
 
     // for receiving
     std::mutex          m_recv_buff_mtx_;
-    char*               m_recv_buff_;
-    size_t              m_recv_buff_size_;
-    size_t              m_recv_buff_allcasize_;
+    Buffer              m_recv_buff_;
+    // a process function on a worker reads `m_recv_buff_` in place, no other thread moves it until then and new bytes go to `m_recv_inbound_`
+    bool                m_recv_pinned_;
+    Buffer              m_recv_inbound_;
+    // bytes from the read cursor known to contain no `m_recv_scan_delimiter_`, so the next search can resume from here
+    size_t              m_recv_scan_size_;
+    std::string         m_recv_scan_delimiter_;
     // for sending
     std::mutex          m_send_buff_mtx_;
-    char*               m_send_buff_;
-    size_t              m_send_buff_size_;
-    size_t              m_send_buff_allcasize_;
+    SendQueue           m_send_buff_;
+    uint64_t            m_enqueue_us_;      // when the queue became non-empty, `0` when not timed
+    size_t              m_send_chunk_;      // max bytes of one `sendmsg`, guarded by `m_send_buff_mtx_`
+    int                 m_send_buffer_;     // `SO_SNDBUF` set by the adaptive policy, `0` when not set
+    uint64_t            m_adapt_ms_;        // when the adaptive policy reads `TCP_INFO` next
+    // for backpressure, guarded by `m_send_buff_mtx_`
+    size_t              m_high_watermark_;
+    size_t              m_low_watermark_;
+    bool                m_above_watermark_; // high watermark reached, waiting to drain to the low one
+    // `SO_ZEROCOPY` is set and large sends use `MSG_ZEROCOPY`, guarded by `m_send_buff_mtx_`
+    bool                m_zerocopy_;
+    // half-closed and its input is processed, closed once the send buffer is empty, guarded by `m_send_buff_mtx_`
+    bool                m_close_drained_;
+    // source of the front relay which has nothing to read, the send waits for it instead of the socket, guarded by `m_send_buff_mtx_`
+    int                 m_relay_wait_fd_;
 
-    const std::function<void(ConnectionPtr)> m_coninit_func_;
-    const std::function<void(ConnectionPtr)> m_process_func_;
-    const std::function<void(ConnectionPtr)> m_cleanup_func_;
+    const EndpointFuncsPtr      m_funcs_;
+    const TransportPolicyPtr    m_policy_;
 public:
     const int           m_fd_;
 
 private:
+    /// @brief Create a connection accepted by `endpoint`
     Connection(int fd, EndpointPtr& endpoint);
 
+    /// @brief Create an outbound connection of `core`
+    /// @param connecting the non-blocking connect is still in progress
+    Connection(int fd, Core* core, const EndpointFuncsPtr& funcs, const TransportPolicyPtr& policy, const bool connecting);
+
 public:
     ~Connection();
 
@@ -62,9 +142,34 @@ public:
     /// @return `bool`: connection alive(`true`) / closed(`false`)
     bool IsConn();
 
-    /// @brief Close socket fd in thread-safe way
+    /// @brief Get the connecting status of an outbound connection
+    /// @return `bool`: connect in progress(`true`) / established or accepted(`false`)
+    /// @note Messages enqueued while connecting are sent once it is established. A connection closed while still connecting has failed to connect.
+    bool IsConnecting();
+
+    /// @brief Get the half-closed status of the connection
+    /// @return `bool`: the peer has finished sending(`true`) / still sending, or closed(`false`)
+    /// @note Input received before the peer finished is processed as usual, then the connection is closed once the messages enqueued so far are sent.
+    bool IsPeerClosed();
+
+    /// @brief Close the connection in thread-safe way
+    /// @note The socket is shut down at once, the fd is closed by the reactor after unregistering the connection,
+    /// so the fd is never reused while the reactor still watches it.
     void CloseConn();
 
+    /// @brief Set a timeout for this connection only, it overrides the one from `Endpoint`
+    /// @param type which timeout to set
+    /// @param timeout_ms timeout in milliseconds, `0` to disable
+    void SetTimeout(const TimeoutType type, const uint32_t timeout_ms);
+
+    /// @brief Set the send buffer watermarks for this connection only, they override the ones from `TransportPolicy`
+    /// @param high_watermark buffered bytes which run the high watermark function of endpoint, `0` to disable
+    /// @param low_watermark buffered bytes which run the drained function of endpoint after the high watermark is reached
+    void SetWatermarks(const size_t high_watermark, const size_t low_watermark);
+
+    /// @brief Get the bytes in send buffer waiting to be sent
+    size_t Buffered();
+
     /// @brief Read a `std::string` message from connection's recv buff splited by `delimiter`
     /// @param delimiter the delimiter for msg string. example: \\r\\n
     /// @param keep_read return the status of whether the program needs to continue reading
@@ -75,39 +180,229 @@ public:
     /// @param size the length of message you want
     /// @return `char*`: a byte-array message
     char* ReadBytes(const size_t size);
+
+    /// @brief Peek all the readable bytes in connection's recv buff without copying
+    /// @return `BufferView`: a view of the readable bytes
+    /// @note Only call it inside the process function. The view stays valid until `Consume` is called or the process function returns.
+    /// On a worker, bytes received while the process function runs are handed to its next run.
+    BufferView Peek();
+
+    /// @brief Mark byte(s) in connection's recv buff as read
+    /// @param size the length of bytes you have used, usually a part of the `BufferView` from `Peek`
+    void Consume(const size_t size);
+
+    /// @brief Hand every complete message splited by `delimiter` to `frame_func` in place, without copying
+    /// @param delimiter the delimiter for msg string. example: \\r\\n
+    /// @param frame_func function like `void(const BufferView& msg)`, the view is only valid inside the function
+    /// @return `size_t`: count of messages handed to `frame_func`
+    /// @note Don't call other read methods of this connection inside `frame_func`.
+    template <typename FrameFunc>
+    size_t ReadStrings(const std::string& delimiter, FrameFunc&& frame_func);
+
+    /// @brief Hand `size` byte(s) of message to `frame_func` in place, without copying
+    /// @param size the length of message you want
+    /// @param frame_func function like `void(const BufferView& msg)`, the view is only valid inside the function
+    /// @return `bool`: message handed(`true`) / not enough data(`false`)
+    /// @note Don't call other read methods of this connection inside `frame_func`.
+    template <typename FrameFunc>
+    bool ReadBytes(const size_t size, FrameFunc&& frame_func);
+
+    /// @brief Split recv buff into frames by `codec` and hand every complete frame to `frame_func` in place, without copying
+    /// @param codec a framing codec. example: `LengthPrefixCodec<uint32_t>()`, `VarintCodec<>()`, `FixedSizeCodec<64>()`
+    /// @param frame_func function like `void(const BufferView& frame)`, the view is only valid inside the function
+    /// @return `size_t`: count of frames handed to `frame_func`
+    /// @note The connection is closed when `codec` finds invalid data. Don't call other read methods of this connection inside `frame_func`.
+    template <typename CodecType, typename FrameFunc>
+    size_t ReadFrames(const CodecType& codec, FrameFunc&& frame_func);
+
+    /// @brief Same as `ReadStrings`, delimiter search resumes from where the previous one stopped.
+    template <typename FrameFunc>
+    size_t ReadFrames(const DelimiterCodec& codec, FrameFunc&& frame_func);
     
     /// @brief Enqueue your message to connection's send buffer
     /// @param msg message you want to send
     /// @param len length of message
+    /// @return `size_t`: bytes in send buffer waiting to be sent, including `msg` / `0` when the connection is closed
     /// @note All the char array message need to push into the send buff by this method, then the `Endpoint` will send your `msg` if it can.
-    void MsgEnqueue(const char* msg, const size_t len);
+    size_t MsgEnqueue(const char* msg, const size_t len);
 
     /// @brief Enqueue your string message to connection's send buffer
     /// @param msg message you want to send
+    /// @return `size_t`: bytes in send buffer waiting to be sent, including `msg` / `0` when the connection is closed
     /// @note All the std::string message need to push into the send buff by this method, then the `Endpoint` will send your `msg` if it can.
-    void MsgEnqueue(const std::string msg);
+    size_t MsgEnqueue(const std::string& msg);
+
+    /// @brief Move your string message into connection's send buffer without copying
+    /// @param msg message you want to send, it will be sent directly from this string
+    /// @return `size_t`: bytes in send buffer waiting to be sent, including `msg` / `0` when the connection is closed
+    size_t MsgEnqueue(std::string&& msg);
+
+    /// @brief Enqueue a shared message to connection's send buffer, only the reference is stored
+    /// @param msg message you want to send, it must not be modified after enqueued
+    /// @return `size_t`: bytes in send buffer waiting to be sent, including `msg` / `0` when the connection is closed
+    /// @note Use `Endpoint::Broadcast` to send one message to many connections.
+    size_t MsgEnqueue(const MessagePtr& msg);
+
+    /// @brief Enqueue `len` bytes of a file from `offset`, they are sent by `sendfile` without being read into memory
+    /// @param fd a regular file opened for reading, it is duplicated so you may close yours right after
+    /// @return `size_t`: bytes in send buffer waiting to be sent, including the file range / `0` when the connection is closed or `fd` is invalid
+    /// @note The range is read when it is sent, not when enqueued. The connection is closed if the file is shorter than the range.
+    /// Files count toward the watermarks but not toward the max buffer size, so any size can be sent.
+    size_t EnqueueFile(const int fd, const off_t offset, const size_t len);
+
+    /// @brief Enqueue a relay of up to `len` bytes from a pipe or socket, they are moved by `splice` without passing through user memory
+    /// @param fd a pipe or socket, it is duplicated so you may close yours right after, its flags are not changed
+    /// @return `size_t`: bytes in send buffer waiting to be sent, including the relay / `0` when the connection is closed or `fd` is invalid
+    /// @note When `fd` has nothing to read, the relay waits until it is readable, and messages enqueued after it wait too.
+    /// The relay ends early when `fd` reaches the end of stream or fails. Don't read `fd` elsewhere until the relay is sent.
+    /// Don't relay from a connection of this library, its data is received by the reactor.
+    size_t EnqueueRelay(const int fd, const size_t len);
 
 private:
-    /// @brief
-    /// Check and extend buffer if needed. When reach max buffer size, `Connection::CloseConn` will also run inside this method. This method is only for `Connection`.
-    /// @return `bool`: buffer allocated or no need to extend(`true`) / reach max buffer size(`false`)
-    bool ExtendBuffer(char*& buff_ptr, size_t target_size, size_t& curr_size, size_t& allocsize);
+    /// @brief Check if the send buffer can take `len` more bytes. When reach max buffer size, `Connection::CloseConn` will also run inside this method.
+    /// @note `m_send_buff_mtx_` must be locked before calling this method.
+    /// @return `bool`: buffer has enough space(`true`) / reach max buffer size(`false`)
+    bool CheckSendBuffer(const size_t len);
 
-    /// @brief Recevie message with non-blocking mode.
-    /// @note This method is only for `Endpoint`.
-    /// @return `bool`: recieving process is success(`true`) / failure(`false`)
-    bool TryRecv();
+    /// @brief Remember when a message is enqueued into the empty send buffer, for the enqueue-to-wire histogram.
+    /// @note `m_send_buff_mtx_` must be locked before calling this method.
+    void StampEnqueue();
+
+    /// @brief Count sent bytes and record the enqueue-to-wire time of the timed message.
+    /// @note `m_send_buff_mtx_` must be locked before calling this method.
+    void RecordSent(const size_t sent);
+
+    /// @brief Size send chunk and `SO_SNDBUF` from the congestion window and RTT in `TCP_INFO`, at most once per `kAdaptIntervalMs`.
+    /// @note `m_send_buff_mtx_` must be locked before calling this method. Nothing is done unless the policy is adaptive.
+    void AdaptTransport(const uint64_t now);
+
+    /// @brief Mark the high watermark as reached when the send buffer grows to it.
+    /// @note `m_send_buff_mtx_` must be locked before calling this method.
+    /// @return `bool`: just reached, run the high watermark function after unlocking(`true`) / no change(`false`)
+    bool CrossHighWatermark();
+
+    /// @brief Clear the high watermark mark when the send buffer drains to the low watermark.
+    /// @note `m_send_buff_mtx_` must be locked before calling this method.
+    /// @return `bool`: just drained, run the drained function after unlocking(`true`) / no change(`false`)
+    bool CrossLowWatermark();
+
+    /// @brief Run the high watermark function or the drained function of endpoint.
+    /// @note `m_send_buff_mtx_` must not be locked, the function may enqueue messages.
+    void RunWatermarkFunc(const bool high);
+
+    /// @brief Put a reference of shared message into send buffer without scheduling send.
+    /// @param buffered return the bytes in send buffer waiting to be sent
+    /// @return `bool`: the connection need to be scheduled to send(`true`) / no need(`false`)
+    bool PushMsg(const MessagePtr& msg, size_t& buffered);
+
+    /// @brief Put a file or relay taken from the caller into send buffer and schedule send.
+    /// @param fd owned by the send buffer from now on
+    /// @return `size_t`: bytes in send buffer waiting to be sent
+    size_t EnqueueFd(const int fd, const off_t offset, const size_t len, const bool relay);
+
+    /// @brief Find the first `delimiter` in recv buff after `offset`, resume from the end of the previous search if possible.
+    /// @note `m_recv_buff_mtx_` must be locked before calling this method, or it is called by the process function,
+    /// which is the only one moving the recv buff while it runs.
+    /// @return `size_t`: index of the delimiter from the read cursor / `std::string::npos` when not found
+    size_t ScanRecvBuff(const std::string& delimiter, const size_t offset);
+
+    /// @brief Mark byte(s) in recv buff as read and move the resume point of delimiter search with them.
+    /// @note `m_recv_buff_mtx_` must be locked before calling this method.
+    void ConsumeRecvBuff(const size_t size);
+
+    /// @brief Keep the readable bytes of recv buff in place while the process function runs on a worker, new bytes are received beside them.
+    /// @note This method is only for `WorkerPool`.
+    void PinRecvBuff();
+
+    /// @brief Append the bytes received while pinned to recv buff, the connection is closed when it reaches the max buffer size.
+    /// @note This method is only for `WorkerPool`, after the process function returns.
+    void UnpinRecvBuff();
+
+    /// @brief Mark the connection as closed and shut the socket down, the fd stays open until `CloseFd`.
+    /// @return `bool`: closed by this call(`true`) / closed already(`false`)
+    bool SetClosed();
+
+    /// @brief Close the fd once, after the connection is unregistered.
+    /// @note This method is only for `Reactor` and the destructor. `m_send_buff_mtx_` must not be locked.
+    /// Buffers of zero-copy sends which are not completed are dropped by the kernel with an abortive close.
+    void CloseFd();
+
+    /// @brief Keep the fd open after unregistering while zero-copy sends are not completed, the kernel may still read their buffers.
+    /// @note This method is only for `Reactor`.
+    /// @return `bool`: the fd stays open until `FinishLinger`(`true`) / nothing to wait for, close it by `CloseFd`(`false`)
+    bool Linger();
+
+    /// @brief Read the completions of a lingering connection, close the fd once all zero-copy sends are completed.
+    /// @note This method is only for `Reactor`.
+    /// @param abort close it now, the kernel drops the data it still holds
+    /// @return `bool`: the fd is closed(`true`) / still lingering(`false`)
+    bool FinishLinger(const bool abort);
+
+    /// @brief Close the connection once the send buffer is empty, right now when it is empty already.
+    /// @note This method is only for `Reactor` and `WorkerPool`, after processing all input of a half-closed connection.
+    void CloseWhenDrained();
+
+    /// @brief Recevie message with non-blocking mode, until nothing is left to read or the peer has finished sending.
+    /// @note This method is only for `Reactor`.
+    /// @param peer_closed set when the peer has finished sending, the received bytes are still to be processed
+    /// @return `bool`: there is input to process(`true`) / nothing new at the end of the peer's stream, or the connection is closed(`false`)
+    bool TryRecv(bool& peer_closed);
+
+    /// @brief Read zero-copy completions from the socket error queue and release the buffers the kernel is done with.
+    /// @note This method is only for `Reactor`, called when `EPOLLERR` comes.
+    /// @return `bool`: only completions were there(`true`) / the socket has a real error(`false`)
+    bool ReadErrorQueue();
+
+    /// @brief Check the result of the non-blocking connect after the socket becomes writable or fails.
+    /// @note This method is only for `Reactor`.
+    /// @return `bool`: established(`true`) / failed, the connection is closed(`false`)
+    bool FinishConnect();
+
+    /// @brief Append bytes received by the io_uring backend to recv buff.
+    /// @note This method is only for `Reactor`.
+    /// @return `bool`: appended(`true`) / connection closed or reach max buffer size(`false`)
+    bool AsyncRecv(const char* data, const size_t len);
+
+    /// @brief Fill the msghdr of async send with queued messages, the queued buffers are frozen until `CompleteAsyncSend`.
+    /// @note This method is only for `Reactor`.
+    /// @return `bool`: there are messages to send(`true`) / nothing to send(`false`)
+    bool PrepareAsyncSend();
+
+    /// @brief Remove the sent bytes after an async send completes.
+    /// @note This method is only for `Reactor`.
+    /// @param result result of the async send, count of sent bytes or -errno
+    /// @return `bool`: need to send again(`true`) / no need(`false`)
+    bool CompleteAsyncSend(int result);
 
     /// @brief Set send flag when the connection is avaliable to send.
     /// @note This method is only for `Endpoint`.
     void SetSendFlag();
 
     /// @brief Check If this connection need to send message.
-    /// @note This method is only for `Endpoint`.
+    /// @note This method is only for `Reactor`.
     /// @return `bool`: is there are any data need to send
     bool NeedSend();
 
-    /// @brief Send message in send buffer with non-blocking mode.
+    /// @brief Get the timer node of `type`
+    TimerNode* GetTimer(const TimeoutType type);
+
+    /// @brief Arm or cancel the read timer after the process function, depends on whether an incomplete message is left.
+    /// @note This method is only for `Reactor` and `WorkerPool`.
+    void UpdateReadTimer();
+
+    /// @brief Check an expired timer, run timeout function or close connection if it is really timeout, otherwise arm it again.
+    /// @note This method is only for `Reactor`.
+    void HandleTimeout(const TimeoutType type);
+
+    /// @brief The source of the front relay is readable, stop waiting for it and send again.
+    /// @note This method is only for `Reactor`.
+    void ResumeRelay();
+
+    /// @brief Stop watching the source of the front relay, before it can be closed.
+    /// @note `m_send_buff_mtx_` must be locked before calling this method.
+    void UnwatchRelay();
+
+    /// @brief Send messages in send buffer with non-blocking mode, up to `kMaxIovCount` messages and the send chunk of policy in one `sendmsg`.
     /// @note This method is only for `Endpoint`.
     /// @return `int`: count of sent bytes(`>0`) / connection closed(`0`) / can't send currently(`<0`)
     int TrySend();
@@ -8,25 +8,57 @@
 namespace SafetyTcpConn {
 
 Connection::Connection(int fd, EndpointPtr& endpoint) :
+    Connection(fd, endpoint->m_core_, endpoint->m_funcs_, endpoint->m_policy_, false)
+{
+    m_endpoint_ = endpoint;
+    for (int i = 0; i < (int)TimeoutType::kCount; i++)
+        m_timeouts_[i].store(endpoint->m_timeouts_[i].load());
+}
+
+Connection::Connection(int fd, Core* core, const EndpointFuncsPtr& funcs, const TransportPolicyPtr& policy, const bool connecting) :
     Container(ContainerType::kConnection),
-    m_fd_(fd), m_endpoint_(endpoint), m_core_(endpoint->m_core_), m_connected_(true), m_send_flag_(true),
-    m_recv_buff_size_(0), m_recv_buff_allcasize_(kDefaultSize), m_recv_buff_(new char[kDefaultSize]),
-    m_send_buff_size_(0), m_send_buff_allcasize_(kDefaultSize), m_send_buff_(new char[kDefaultSize]),
-    m_coninit_func_(endpoint->m_coninit_func_), m_process_func_(endpoint->m_process_func_), m_cleanup_func_(endpoint->m_cleanup_func_)
+    m_connected_(true), m_connecting_(connecting), m_registered_(false), m_peer_closed_(false), m_fd_closed_(false), m_lingering_(false), m_send_flag_(!connecting),
+    m_last_active_ms_(Reactor::NowMs()), m_last_send_ms_(0), m_stall_since_ms_(0),
+    m_send_stall_timer_(this, TimeoutType::kSendStall), m_idle_timer_(this, TimeoutType::kIdle), m_read_timer_(this, TimeoutType::kRead),
+    m_connect_timer_(this, TimeoutType::kConnect),
+    m_timer_closed_(false), m_read_pending_(false), m_strand_pending_(0), m_cleanup_pending_(false), m_send_queued_(false),
+    m_uring_inflight_(0), m_uring_sending_(false), m_core_(core),
+    m_recv_buff_(kDefaultSize, policy->m_max_buffer_size_), m_recv_pinned_(false), m_recv_inbound_(kDefaultSize, policy->m_max_buffer_size_), m_recv_scan_size_(0), m_enqueue_us_(0),
+    m_send_chunk_(policy->m_send_chunk_), m_send_buffer_(0), m_adapt_ms_(0),
+    m_high_watermark_(policy->m_high_watermark_), m_low_watermark_(policy->m_low_watermark_), m_above_watermark_(false), m_zerocopy_(false), m_close_drained_(false), m_relay_wait_fd_(-1),
+    m_funcs_(funcs), m_policy_(policy), m_fd_(fd)
 {
-    int send_buff_size = 8192;
-    if (setsockopt(m_fd_, SOL_SOCKET, SO_SNDBUF, &send_buff_size, sizeof(send_buff_size)) < 0) {
+    m_timeouts_[(int)TimeoutType::kSendStall].store(policy->m_send_stall_timeout_ms_);
+    m_timeouts_[(int)TimeoutType::kIdle].store(0);
+    m_timeouts_[(int)TimeoutType::kRead].store(0);
+    m_timeouts_[(int)TimeoutType::kConnect].store(connecting ? policy->m_connect_timeout_ms_ : 0);
+
+    // keep the kernel default when not set, it is auto-tuned
+    int send_buff_size = m_policy_->m_send_buffer_;
+    if (send_buff_size > 0 && setsockopt(m_fd_, SOL_SOCKET, SO_SNDBUF, &send_buff_size, sizeof(send_buff_size)) < 0) {
         std::cerr << "SafetyTcpConn >> Connection >> Error >> Set Socket Send Buffer Size Failure." << std::endl;
         CloseConn();
         return;
     }
 
     int cork = 1;
-    if (setsockopt(m_fd_, IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork)) < 0) {
-        std::cerr << "SafetyTcpConn >> Connection >> Error >> Set Socket Send Buffer Size Failure." << std::endl;
+    if (m_policy_->m_cork_ && setsockopt(m_fd_, IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork)) < 0) {
+        std::cerr << "SafetyTcpConn >> Connection >> Error >> Set Socket TCP_CORK Failure." << std::endl;
+        CloseConn();
+        return;
+    }
+
+    int no_delay = 1;
+    if (m_policy_->m_no_delay_ && setsockopt(m_fd_, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay)) < 0) {
+        std::cerr << "SafetyTcpConn >> Connection >> Error >> Set Socket TCP_NODELAY Failure." << std::endl;
         CloseConn();
         return;
     }
+
+    // not supported by the kernel, every send copies as before
+    int zerocopy = 1;
+    if (m_policy_->m_zerocopy_threshold_ > 0)
+        m_zerocopy_ = setsockopt(m_fd_, SOL_SOCKET, SO_ZEROCOPY, &zerocopy, sizeof(zerocopy)) == 0;
 }
 
 //==============================
@@ -34,31 +66,58 @@ Connection::Connection(int fd, EndpointPtr& endpoint) :
 //==============================
 
 Connection::~Connection() {
-    // close connection if not close
-    CloseConn();
-    // release buffer
-    delete [] m_recv_buff_;
-    delete [] m_send_buff_;
+    // close connection if not close, nothing can be posted to the reactor any more
+    SetClosed();
+    m_lingering_ = false;
+    CloseFd();
 }
 
 inline bool Connection::IsConn() {
     return m_connected_.load();
 }
 
+inline bool Connection::IsConnecting() {
+    return m_connecting_.load();
+}
+
+inline bool Connection::IsPeerClosed() {
+    return m_connected_.load() && m_peer_closed_.load();
+}
+
 inline void Connection::CloseConn() {
-    bool conn_state = m_connected_.load();
-    // no need to close connection
-    if (!conn_state) return;
+    if (!SetClosed())
+        return;
 
-    // atomic to set m_connected to false
-    while (!m_connected_.compare_exchange_weak(conn_state, false)) {
-        // connection will be close by another thread
-        if (conn_state == false)
-            return;
-    }
+    // the reactor unregisters it and closes the fd, a connection not registered yet is posted by `RegisterContainer`
+    if (m_registered_.load())
+        m_reactor_->PostClose(shared_from_this());
+}
 
-    // close connection
-    close(m_fd_);
+inline void Connection::SetTimeout(const TimeoutType type, const uint32_t timeout_ms) {
+    if (type == TimeoutType::kCount) return;
+    m_timeouts_[(int)type].store(timeout_ms);
+
+    // not registered yet, timers will be armed when registering
+    if (m_reactor_ == nullptr) return;
+
+    if (timeout_ms == 0)
+        m_reactor_->CancelTimer(this, type);
+    else if (type == TimeoutType::kIdle)
+        m_reactor_->ArmTimer(this, type, m_last_active_ms_.load() + timeout_ms, false);
+}
+
+inline void Connection::SetWatermarks(const size_t high_watermark, const size_t low_watermark) {
+    std::unique_lock<std::mutex> lck(m_send_buff_mtx_);
+    m_high_watermark_ = high_watermark;
+    m_low_watermark_ = low_watermark;
+    // disabled, don't wait for a drain that is never reported
+    if (m_high_watermark_ == 0)
+        m_above_watermark_ = false;
+}
+
+inline size_t Connection::Buffered() {
+    std::unique_lock<std::mutex> lck(m_send_buff_mtx_);
+    return m_send_buff_.Size();
 }
 
 inline std::string Connection::ReadString(const std::string delimiter, bool& keep_read) {
@@ -71,29 +130,22 @@ inline std::string Connection::ReadString(const std::string delimiter, bool& kee
     const size_t delimiter_size = delimiter.size();
 
     std::unique_lock<std::mutex> lck(m_recv_buff_mtx_);
-    if (m_recv_buff_size_ < delimiter_size)
+    const size_t recv_buff_size = m_recv_buff_.Size();
+    if (recv_buff_size < delimiter_size)
         return "";
 
-    std::string msg = std::string();
+    const size_t msg_size = ScanRecvBuff(delimiter, 0);
+    if (msg_size == std::string::npos)
+        return "";
 
-    for (int start_index = 0; start_index <= m_recv_buff_size_ - delimiter_size; start_index++) {
-        size_t end_index = start_index + delimiter_size;
-        
-        if (std::string(m_recv_buff_ + start_index, m_recv_buff_ + end_index) != delimiter)
-            continue;
-        
-        // copy msg data into string container
-        msg.append(m_recv_buff_, m_recv_buff_ + start_index);
+    // copy msg data into string container
+    std::string msg = std::string(m_recv_buff_.Data(), msg_size);
 
-        // move other data to the front
-        std::memmove(m_recv_buff_, m_recv_buff_ + end_index, m_recv_buff_size_ - end_index);
-        // reset buff size
-        m_recv_buff_size_ -= end_index;
+    // mark msg and delimiter as read
+    ConsumeRecvBuff(msg_size + delimiter_size);
 
-        // set keep read if still have message not readed
-        keep_read = true;
-        break;
-    }
+    // set keep read if still have message not readed
+    keep_read = true;
 
     return msg;
 }
@@ -103,112 +155,525 @@ inline char* Connection::ReadBytes(const size_t size) {
         return nullptr;
 
     std::unique_lock<std::mutex> lck(m_recv_buff_mtx_);
-    if (m_recv_buff_size_ < size)
+    if (m_recv_buff_.Size() < size)
         return nullptr;
 
-    const size_t size_after_read = m_recv_buff_size_ - size;
-
     // copy message from recv buff to read buff
     char* buff = new char[size];
-    std::memcpy(buff, m_recv_buff_, size);
-
-    // move other data to the front
-    std::memmove(m_recv_buff_, m_recv_buff_ + size, size_after_read);
+    std::memcpy(buff, m_recv_buff_.Data(), size);
 
-    // reset buff size
-    m_recv_buff_size_ = size_after_read;
+    // mark message as read
+    ConsumeRecvBuff(size);
 
     return buff;
 }
 
-inline void Connection::MsgEnqueue(const char* msg, const size_t len) {
-    if (!IsConn()) return;
+inline BufferView Connection::Peek() {
+    std::unique_lock<std::mutex> lck(m_recv_buff_mtx_);
+    return BufferView(m_recv_buff_.Data(), m_recv_buff_.Size());
+}
+
+inline void Connection::Consume(const size_t size) {
+    std::unique_lock<std::mutex> lck(m_recv_buff_mtx_);
+    ConsumeRecvBuff(size);
+}
+
+template <typename FrameFunc>
+inline size_t Connection::ReadStrings(const std::string& delimiter, FrameFunc&& frame_func) {
+    if (!m_connected_.load() || delimiter.size() == 0)
+        return 0;
+
+    const size_t delimiter_size = delimiter.size();
+    size_t count = 0;
+
+    std::unique_lock<std::mutex> lck(m_recv_buff_mtx_);
+    const char* recv_buff = m_recv_buff_.Data();
+    const size_t recv_buff_size = m_recv_buff_.Size();
+    // the readable bytes stay in place until consumed, `frame_func` runs without the lock and may take as long as it needs
+    lck.unlock();
+
+    // hand all complete messages in place, consume them once at the end
+    size_t offset = 0;
+    while (recv_buff_size - offset >= delimiter_size) {
+        const size_t delimiter_index = ScanRecvBuff(delimiter, offset);
+        if (delimiter_index == std::string::npos)
+            break;
+
+        frame_func(BufferView(recv_buff + offset, delimiter_index - offset));
+        offset = delimiter_index + delimiter_size;
+        count++;
+    }
+
+    lck.lock();
+    ConsumeRecvBuff(offset);
+    return count;
+}
+
+template <typename FrameFunc>
+inline bool Connection::ReadBytes(const size_t size, FrameFunc&& frame_func) {
+    if (!m_connected_.load())
+        return false;
+
+    std::unique_lock<std::mutex> lck(m_recv_buff_mtx_);
+    if (m_recv_buff_.Size() < size)
+        return false;
+
+    // the bytes stay in place until consumed, `frame_func` runs without the lock
+    const char* recv_buff = m_recv_buff_.Data();
+    lck.unlock();
+    frame_func(BufferView(recv_buff, size));
+
+    lck.lock();
+    ConsumeRecvBuff(size);
+    return true;
+}
+
+template <typename CodecType, typename FrameFunc>
+inline size_t Connection::ReadFrames(const CodecType& codec, FrameFunc&& frame_func) {
+    if (!m_connected_.load())
+        return 0;
+
+    size_t count = 0;
+
+    std::unique_lock<std::mutex> lck(m_recv_buff_mtx_);
+    const char* recv_buff = m_recv_buff_.Data();
+    const size_t recv_buff_size = m_recv_buff_.Size();
+    // the readable bytes stay in place until consumed, `frame_func` runs without the lock and may take as long as it needs
+    lck.unlock();
 
+    // hand all complete frames in place, consume them once at the end
+    size_t offset = 0;
+    while (offset < recv_buff_size) {
+        BufferView frame;
+        const size_t used = codec.Decode(recv_buff + offset, recv_buff_size - offset, frame);
+        if (used == Codec::kIncomplete)
+            break;
+
+        // invalid data, can't find the next frame any more
+        if (used == Codec::kError) {
+            CloseConn();
+            break;
+        }
+
+        frame_func(frame);
+        offset += used;
+        count++;
+    }
+
+    lck.lock();
+    ConsumeRecvBuff(offset);
+    return count;
+}
+
+template <typename FrameFunc>
+inline size_t Connection::ReadFrames(const DelimiterCodec& codec, FrameFunc&& frame_func) {
+    return ReadStrings(codec.Delimiter(), std::forward<FrameFunc>(frame_func));
+}
+
+inline size_t Connection::MsgEnqueue(const char* msg, const size_t len) {
+    if (!IsConn()) return 0;
+
+    size_t buffered = 0;
+    bool high = false;
     // append msg in to send buff
     {
         std::unique_lock<std::mutex> lck(m_send_buff_mtx_);
 
-        // calculate the total size of data
-        const size_t total_data_len = m_send_buff_size_ + len;
-
-        // check if buff size is enough, if not then extend it
-        if (!ExtendBuffer(m_send_buff_, total_data_len, m_send_buff_size_, m_send_buff_allcasize_))
-            return;
+        // check if buff size is enough
+        if (!CheckSendBuffer(len))
+            return 0;
+        StampEnqueue();
 
         // copy msg's data into the end of buff
-        memcpy(m_send_buff_ + m_send_buff_size_, msg, len);
-        m_send_buff_size_ = total_data_len;
+        m_send_buff_.Push(msg, len);
+        buffered = m_send_buff_.Size();
+        high = CrossHighWatermark();
     }
 
     if (m_send_flag_.load())
-        m_core_->StartTrySend();
+        m_reactor_->ScheduleSend(shared_from_this());
+    if (high)
+        RunWatermarkFunc(true);
+
+    return buffered;
 }
 
-inline void Connection::MsgEnqueue(const std::string msg) {
-    this->MsgEnqueue(msg.c_str(), msg.size());
+inline size_t Connection::MsgEnqueue(const std::string& msg) {
+    return this->MsgEnqueue(msg.c_str(), msg.size());
+}
+
+inline size_t Connection::MsgEnqueue(std::string&& msg) {
+    if (!IsConn()) return 0;
+
+    size_t buffered = 0;
+    bool high = false;
+    // move msg in to send buff
+    {
+        std::unique_lock<std::mutex> lck(m_send_buff_mtx_);
+
+        // check if buff size is enough
+        if (!CheckSendBuffer(msg.size()))
+            return 0;
+        StampEnqueue();
+
+        m_send_buff_.Push(std::move(msg));
+        buffered = m_send_buff_.Size();
+        high = CrossHighWatermark();
+    }
+
+    if (m_send_flag_.load())
+        m_reactor_->ScheduleSend(shared_from_this());
+    if (high)
+        RunWatermarkFunc(true);
+
+    return buffered;
+}
+
+inline size_t Connection::MsgEnqueue(const MessagePtr& msg) {
+    size_t buffered = 0;
+    if (PushMsg(msg, buffered))
+        m_reactor_->ScheduleSend(shared_from_this());
+    return buffered;
+}
+
+inline size_t Connection::EnqueueFile(const int fd, const off_t offset, const size_t len) {
+    if (!IsConn()) return 0;
+
+    // the queue keeps its own fd, the caller may close theirs at once
+    const int file_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (file_fd < 0)
+        return 0;
+
+    return EnqueueFd(file_fd, offset, len, false);
+}
+
+inline size_t Connection::EnqueueRelay(const int fd, const size_t len) {
+    if (!IsConn()) return 0;
+
+    // the source is only read when it is readable, its flags are left as they are
+    const int relay_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (relay_fd < 0)
+        return 0;
+
+    return EnqueueFd(relay_fd, 0, len, true);
 }
 
 //==============================
 // Endpoint Control Area
 //==============================
 
-inline bool Connection::ExtendBuffer(char*& buff_ptr, size_t future_size, size_t& curr_size, size_t& allocsize) {
-    // check if need to extend
-    if (future_size > allocsize) {
-        const size_t target_buff_allocsize = (future_size / kDefaultSize + (size_t)(future_size % kDefaultSize > 0)) * kDefaultSize;
+inline bool Connection::CheckSendBuffer(const size_t len) {
+    // reach max buffer size
+    if (m_send_buff_.MemorySize() + len > m_policy_->m_max_buffer_size_) {
+        Metrics::Add(MetricCounter::kBufferLimitCloses);
+        CloseConn();
+        return false;
+    }
 
-        // reach max allocation size
-        if (target_buff_allocsize > kMaxSize) {
-            CloseConn();
+    return true;
+}
+
+inline void Connection::StampEnqueue() {
+    // only the message which makes the queue non-empty is timed
+    if (m_send_buff_.Empty() && m_enqueue_us_ == 0)
+        m_enqueue_us_ = Metrics::NowUs();
+}
+
+inline void Connection::RecordSent(const size_t sent) {
+    Metrics::Add(MetricCounter::kBytesOut, sent);
+    if (m_enqueue_us_ != 0) {
+        Metrics::Record(MetricHistogram::kEnqueueToWireUs, Metrics::NowUs() - m_enqueue_us_);
+        m_enqueue_us_ = 0;
+    }
+}
+
+inline void Connection::AdaptTransport(const uint64_t now) {
+    if (!m_policy_->m_adaptive_ || now < m_adapt_ms_)
+        return;
+    m_adapt_ms_ = now + kAdaptIntervalMs;
+
+    tcp_info info{};
+    socklen_t length = sizeof(info);
+    if (getsockopt(m_fd_, IPPROTO_TCP, TCP_INFO, &info, &length) < 0 || info.tcpi_snd_mss == 0)
+        return;
+
+    // the window changes once per round trip, slow paths are sampled less often
+    const uint64_t rtt_ms = info.tcpi_rtt / 1000;
+    if (rtt_ms * 4 > (uint64_t)kAdaptIntervalMs)
+        m_adapt_ms_ = now + rtt_ms * 4;
+
+    // bytes the congestion window lets out in one round trip, no use handing the kernel much more at once
+    const uint64_t window = (uint64_t)info.tcpi_snd_cwnd * info.tcpi_snd_mss;
+    size_t chunk = window < kMinSendChunk ? kMinSendChunk : (size_t)window;
+    if (chunk > m_policy_->m_send_chunk_)
+        chunk = m_policy_->m_send_chunk_;
+    m_send_chunk_ = chunk;
+
+    // room for the window in flight and the next one, so the pipe never waits for the next `sendmsg`.
+    // setting it turns auto-tuning off, only set it when it changes by 25% or more
+    uint64_t target = window * 2;
+    if (target < kMinSendChunk)
+        target = kMinSendChunk;
+    if (target > (uint64_t)kMaxSendBuffer)
+        target = kMaxSendBuffer;
+
+    const int send_buff_size = (int)target;
+    if (m_send_buffer_ != 0 && send_buff_size * 4 > m_send_buffer_ * 3 && send_buff_size * 4 < m_send_buffer_ * 5)
+        return;
+    if (setsockopt(m_fd_, SOL_SOCKET, SO_SNDBUF, &send_buff_size, sizeof(send_buff_size)) == 0)
+        m_send_buffer_ = send_buff_size;
+}
+
+inline bool Connection::CrossHighWatermark() {
+    if (m_high_watermark_ == 0 || m_above_watermark_ || m_send_buff_.Size() < m_high_watermark_)
+        return false;
+
+    m_above_watermark_ = true;
+    return true;
+}
+
+inline bool Connection::CrossLowWatermark() {
+    if (!m_above_watermark_ || m_send_buff_.Size() > m_low_watermark_)
+        return false;
+
+    m_above_watermark_ = false;
+    return true;
+}
+
+inline void Connection::RunWatermarkFunc(const bool high) {
+    EndpointPtr endpoint = m_endpoint_.lock();
+    if (endpoint == nullptr)
+        return;
+
+    ConnectionFunc watermark_func;
+    {
+        std::unique_lock<std::mutex> lck(endpoint->m_mtx_connptrs_);
+        watermark_func = high ? endpoint->m_high_watermark_func_ : endpoint->m_drained_func_;
+    }
+    if (watermark_func)
+        watermark_func(shared_from_this());
+}
+
+inline bool Connection::PushMsg(const MessagePtr& msg, size_t& buffered) {
+    buffered = 0;
+    if (!IsConn() || msg == nullptr) return false;
+
+    bool high = false;
+    {
+        std::unique_lock<std::mutex> lck(m_send_buff_mtx_);
+
+        // check if buff size is enough
+        if (!CheckSendBuffer(msg->size()))
             return false;
-        }
+        StampEnqueue();
+
+        m_send_buff_.Push(msg);
+        buffered = m_send_buff_.Size();
+        high = CrossHighWatermark();
+    }
+
+    // the message is queued already, it is sent even if the function closes the connection
+    if (high)
+        RunWatermarkFunc(true);
+
+    return m_send_flag_.load();
+}
+
+inline size_t Connection::EnqueueFd(const int fd, const off_t offset, const size_t len, const bool relay) {
+    size_t buffered = 0;
+    bool high = false;
+    {
+        std::unique_lock<std::mutex> lck(m_send_buff_mtx_);
+        StampEnqueue();
+
+        // files take no memory, they are not limited by the max buffer size
+        if (relay)
+            m_send_buff_.PushRelay(fd, len);
+        else
+            m_send_buff_.PushFile(fd, offset, len);
+        buffered = m_send_buff_.Size();
+        high = CrossHighWatermark();
+    }
+
+    if (m_send_flag_.load())
+        m_reactor_->ScheduleSend(shared_from_this());
+    if (high)
+        RunWatermarkFunc(true);
+
+    return buffered;
+}
+
+inline size_t Connection::ScanRecvBuff(const std::string& delimiter, const size_t offset) {
+    const char* recv_buff = m_recv_buff_.Data();
+    const size_t recv_buff_size = m_recv_buff_.Size();
+    const size_t delimiter_size = delimiter.size();
+
+    // resume from the end of the previous search with the same delimiter
+    size_t start = offset;
+    if (m_recv_scan_delimiter_ != delimiter) {
+        m_recv_scan_delimiter_ = delimiter;
+        m_recv_scan_size_ = 0;
+    }
+    else if (m_recv_scan_size_ > start) {
+        start = m_recv_scan_size_;
+    }
+
+    if (start >= recv_buff_size)
+        return std::string::npos;
+
+    const size_t index = Scanner::Find(recv_buff + start, recv_buff_size - start, delimiter.data(), delimiter_size);
+    if (index == std::string::npos) {
+        // the last (delimiter_size - 1) bytes may be the beginning of a delimiter
+        if (recv_buff_size - start >= delimiter_size)
+            m_recv_scan_size_ = recv_buff_size - delimiter_size + 1;
+        return std::string::npos;
+    }
+
+    m_recv_scan_size_ = start + index;
+    return start + index;
+}
+
+inline void Connection::ConsumeRecvBuff(const size_t size) {
+    m_recv_buff_.Consume(size);
+    m_recv_scan_size_ = m_recv_scan_size_ > size ? m_recv_scan_size_ - size : 0;
+}
+
+inline void Connection::PinRecvBuff() {
+    std::unique_lock<std::mutex> lck(m_recv_buff_mtx_);
+    m_recv_pinned_ = true;
+}
+
+inline void Connection::UnpinRecvBuff() {
+    std::unique_lock<std::mutex> lck(m_recv_buff_mtx_);
+    m_recv_pinned_ = false;
+    if (m_recv_inbound_.Size() == 0)
+        return;
 
-        // allocate buff
-        char* old_buff = buff_ptr;
-        char* new_buff = new char[target_buff_allocsize];
+    // everything before is read, take the received bytes without copying
+    if (m_recv_buff_.Size() == 0) {
+        m_recv_buff_.Swap(m_recv_inbound_);
+        m_recv_inbound_.Trim();
+        return;
+    }
 
-        // copy old buff's data to new buff
-        memcpy(new_buff, old_buff, curr_size);
+    const bool appended = m_recv_buff_.Append(m_recv_inbound_.Data(), m_recv_inbound_.Size());
+    m_recv_inbound_.Consume(m_recv_inbound_.Size());
+    if (!appended) {
+        Metrics::Add(MetricCounter::kBufferLimitCloses);
+        lck.unlock();
+        CloseConn();
+    }
+}
 
-        // replace buff ptr and allocated size
-        buff_ptr = new_buff;
-        allocsize = target_buff_allocsize;
+inline bool Connection::SetClosed() {
+    bool conn_state = m_connected_.load();
+    // no need to close connection
+    if (!conn_state) return false;
 
-        // release old buff memory
-        delete [] old_buff;
+    // atomic to set m_connected to false
+    while (!m_connected_.compare_exchange_weak(conn_state, false)) {
+        // connection will be close by another thread
+        if (conn_state == false)
+            return false;
     }
 
+    // shutdown so that operations in flight on the fd end, and the reactor sees it closed
+    shutdown(m_fd_, SHUT_RDWR);
+    Metrics::Add(MetricCounter::kCloses);
     return true;
 }
 
-inline bool Connection::TryRecv() {
-    constexpr size_t recv_buff_size = 1500;
-    char buff[recv_buff_size];
+inline void Connection::CloseFd() {
+    // the send thread checks the state under the same lock, it never sends on a closed fd
+    std::unique_lock<std::mutex> lck(m_send_buff_mtx_);
+    if (m_fd_closed_ || m_lingering_)
+        return;
+    m_fd_closed_ = true;
+
+    // the kernel may still read the retained buffers, reset the socket so that it drops them before they are released
+    m_send_buff_.Clear();
+    if (m_send_buff_.Retained() > 0) {
+        linger abort{};
+        abort.l_onoff = 1;
+        abort.l_linger = 0;
+        setsockopt(m_fd_, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+    }
+    close(m_fd_);
+}
+
+inline bool Connection::Linger() {
+    std::unique_lock<std::mutex> lck(m_send_buff_mtx_);
+    // nothing is sent any more, items pinned by zero-copy sends are retained
+    m_send_buff_.Clear();
+    m_lingering_ = !m_fd_closed_ && m_send_buff_.Retained() > 0;
+    return m_lingering_;
+}
+
+inline bool Connection::FinishLinger(const bool abort) {
+    ReadErrorQueue();
+    {
+        std::unique_lock<std::mutex> lck(m_send_buff_mtx_);
+        if (!abort && m_send_buff_.Retained() > 0)
+            return false;
+        m_lingering_ = false;
+    }
+    CloseFd();
+    return true;
+}
+
+inline void Connection::CloseWhenDrained() {
+    {
+        std::unique_lock<std::mutex> lck(m_send_buff_mtx_);
+        m_close_drained_ = true;
+        // the send thread closes it once the rest is sent
+        if (!m_send_buff_.Empty())
+            return;
+    }
+    CloseConn();
+}
+
+inline bool Connection::TryRecv(bool& peer_closed) {
+    const size_t recv_buff_size = m_policy_->m_recv_chunk_;
 
     int recved = 0;
+    size_t recved_total = 0;
     {
         std::unique_lock<std::mutex> lck(m_recv_buff_mtx_);
+        // a process function is reading the recv buff in place, receive beside it so that it is not moved
+        Buffer& recv_buff = m_recv_pinned_ ? m_recv_inbound_ : m_recv_buff_;
         while (IsConn()) {
-            recved = recv(m_fd_, buff, recv_buff_size, MSG_DONTWAIT | MSG_NOSIGNAL);
+            // check if buff size is enough, if not then extend it
+            if (!recv_buff.Reserve(recv_buff_size)) {
+                Metrics::Add(MetricCounter::kBytesIn, recved_total);
+                Metrics::Add(MetricCounter::kBufferLimitCloses);
+                CloseConn();
+                return false;
+            }
+
+            // recv into the end of buff directly
+            recved = recv(m_fd_, recv_buff.WriteData(), recv_buff.Writable(), MSG_DONTWAIT | MSG_NOSIGNAL);
 
             // nothing need to recevie
             if (recved <= 0) break;
 
-            // calculate the total size of data
-            const size_t total_data_len = m_recv_buff_size_ + recved;
-
-            // check if buff size is enough, if not then extend it
-            if (!ExtendBuffer(m_recv_buff_, total_data_len, m_recv_buff_size_, m_recv_buff_allcasize_))
-                break; 
-
-            // copy msg's data into the end of buff
-            memcpy(m_recv_buff_ + m_recv_buff_size_, buff, recved);
-            m_recv_buff_size_ = total_data_len;
+            recv_buff.Commit(recved);
+            recved_total += recved;
         }
+
+        // nothing left to read, don't keep the storage reserved for recv
+        recv_buff.Trim();
     }
+    m_last_active_ms_.store(Reactor::NowMs());
+    Metrics::Add(MetricCounter::kBytesIn, recved_total);
     
-    // connection closed / error
-    if (recved == 0 || (recved < 0 && errno != EAGAIN && errno != EINTR)) {
+    // the peer has finished sending, what is received before is processed first
+    if (recved == 0) {
+        peer_closed = true;
+        return recved_total > 0 && IsConn();
+    }
+
+    // error
+    if (recved < 0 && errno != EAGAIN && errno != EINTR) {
         CloseConn();
         return false;
     }
@@ -217,53 +682,440 @@ inline bool Connection::TryRecv() {
     return IsConn();
 }
 
+inline bool Connection::ReadErrorQueue() {
+    while (true) {
+        char control[128];
+        msghdr msg{};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(m_fd_, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+            break;
+
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) && !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+                continue;
+
+            const sock_extended_err* err = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cmsg));
+            if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY || err->ee_errno != 0)
+                return false;
+
+            // sends from `ee_info` to `ee_data` are done with their buffers
+            std::unique_lock<std::mutex> lck(m_send_buff_mtx_);
+            m_send_buff_.CompleteZeroCopy(err->ee_info, err->ee_data);
+
+            // the kernel copied anyway, e.g. loopback or a device without scatter-gather, pinning pages only costs more then
+            if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                Metrics::Add(MetricCounter::kZeroCopyCopied);
+                m_zerocopy_ = false;
+            }
+        }
+    }
+
+    // a real error is pending in the socket, not in the error queue
+    int error = 0;
+    socklen_t length = sizeof(error);
+    return getsockopt(m_fd_, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0;
+}
+
+inline bool Connection::FinishConnect() {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (!IsConn() || getsockopt(m_fd_, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+        CloseConn();
+        return false;
+    }
+
+    m_last_active_ms_.store(Reactor::NowMs());
+    m_connecting_.store(false);
+    Metrics::Add(MetricCounter::kConnects);
+    return true;
+}
+
+inline bool Connection::AsyncRecv(const char* data, const size_t len) {
+    {
+        std::unique_lock<std::mutex> lck(m_recv_buff_mtx_);
+        if (!IsConn())
+            return false;
+
+        // extend buff if it is not enough, close when reach max buffer size, beside it while a process function reads it
+        Buffer& recv_buff = m_recv_pinned_ ? m_recv_inbound_ : m_recv_buff_;
+        if (!recv_buff.Append(data, len)) {
+            Metrics::Add(MetricCounter::kBufferLimitCloses);
+            CloseConn();
+            return false;
+        }
+    }
+    m_last_active_ms_.store(Reactor::NowMs());
+    Metrics::Add(MetricCounter::kBytesIn, len);
+
+    return true;
+}
+
+inline bool Connection::PrepareAsyncSend() {
+    if (!IsConn())
+        return false;
+
+    {
+        std::unique_lock<std::mutex> lck(m_send_buff_mtx_);
+        if (m_send_buff_.Empty())
+            return false;
+
+        if (m_uring_send_ == nullptr)
+            m_uring_send_.reset(new AsyncSend());
+        AdaptTransport(Reactor::NowMs());
+
+        // gather queued messages, they must not move until the send completes.
+        // nothing is gathered when a file or relay is at the front, it is sent once the socket is writable
+        msghdr& msg = m_uring_send_->m_msg_;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = m_uring_send_->m_iov_;
+        msg.msg_iovlen = m_send_buff_.Fill(m_uring_send_->m_iov_, kMaxIovCount, m_send_chunk_);
+        m_send_buff_.Freeze();
+        // a relay whose source has nothing to read waits for the source instead
+        m_relay_wait_fd_ = msg.msg_iovlen == 0 ? m_send_buff_.RelayWaitFd() : -1;
+
+        // messages enqueued while sending are picked up when it completes
+        m_send_flag_.store(false);
+    }
+
+    // the send stall timer closes it if the send never completes
+    const uint32_t timeout_ms = m_timeouts_[(int)TimeoutType::kSendStall].load();
+    if (timeout_ms > 0) {
+        const uint64_t now = Reactor::NowMs();
+        m_stall_since_ms_.store(now);
+        m_reactor_->ArmTimer(this, TimeoutType::kSendStall, now + timeout_ms, true);
+    }
+
+    return true;
+}
+
+inline bool Connection::CompleteAsyncSend(int result) {
+    // disconnected
+    if (result <= 0) {
+        CloseConn();
+        return false;
+    }
+
+    bool need_send = false;
+    bool drained = false;
+    bool close = false;
+    {
+        std::unique_lock<std::mutex> lck(m_send_buff_mtx_);
+        m_send_buff_.Unfreeze();
+        m_relay_wait_fd_ = -1;
+
+        // writable for the file or relay at the front, the result is the poll events
+        if (m_uring_send_->m_msg_.msg_iovlen == 0) {
+            result = 0;
+            if (m_send_buff_.FrontIsFile()) {
+                result = (int)m_send_buff_.SendFile(m_fd_, m_send_chunk_);
+                if (result < 0 && errno != EAGAIN && errno != EINTR) {
+                    CloseConn();
+                    return false;
+                }
+            }
+        }
+        else {
+            m_send_buff_.Consume(result);
+        }
+
+        if (result > 0) {
+            const uint64_t now = Reactor::NowMs();
+            m_last_send_ms_.store(now);
+            m_last_active_ms_.store(now);
+            RecordSent(result);
+        }
+        drained = CrossLowWatermark();
+
+        // sendable again, set it under the lock so that a message enqueued right after is never missed
+        m_send_flag_.store(true);
+        // drained, an idle connection keeps no send state, a half-closed one is done
+        if (m_send_buff_.Empty()) {
+            m_uring_send_.reset();
+            close = m_close_drained_;
+        }
+        else
+            need_send = true;
+    }
+
+    if (drained)
+        RunWatermarkFunc(false);
+
+    if (close) {
+        CloseConn();
+        return false;
+    }
+
+    return need_send && IsConn();
+}
+
 inline void Connection::SetSendFlag() {
     m_send_flag_.store(true);
 }
 
 inline bool Connection::NeedSend() {
-    bool connect_state = m_connected_.load();
-    bool send_flag = m_send_flag_.load();
+    if (!m_connected_.load() || !m_send_flag_.load())
+        return false;
 
-    // when the connection's send is timeout, close connection
-    if (!send_flag && time(nullptr) - m_prev_sendtime_ >= 5) {
+    std::unique_lock<std::mutex> lck(m_send_buff_mtx_);
+    return !m_send_buff_.Empty();
+}
+
+inline TimerNode* Connection::GetTimer(const TimeoutType type) {
+    switch (type) {
+        case TimeoutType::kSendStall:   return &m_send_stall_timer_;
+        case TimeoutType::kIdle:        return &m_idle_timer_;
+        case TimeoutType::kRead:        return &m_read_timer_;
+        case TimeoutType::kConnect:     return &m_connect_timer_;
+        default:                        return nullptr;
+    }
+}
+
+inline void Connection::UpdateReadTimer() {
+    const uint32_t timeout_ms = m_timeouts_[(int)TimeoutType::kRead].load();
+    if (timeout_ms == 0 && !m_read_pending_.load())
+        return;
+
+    bool read_pending = false;
+    {
+        std::unique_lock<std::mutex> lck(m_recv_buff_mtx_);
+        read_pending = m_recv_buff_.Size() > 0;
+    }
+
+    // only touch the timer when the state changes, the deadline starts from the first byte of an incomplete message
+    if (read_pending == m_read_pending_.load())
+        return;
+    m_read_pending_.store(read_pending);
+
+    if (read_pending && timeout_ms > 0)
+        m_reactor_->ArmTimer(this, TimeoutType::kRead, Reactor::NowMs() + timeout_ms, true);
+    else
+        m_reactor_->CancelTimer(this, TimeoutType::kRead);
+}
+
+inline void Connection::HandleTimeout(const TimeoutType type) {
+    if (!IsConn() || type == TimeoutType::kCount)
+        return;
+
+    const uint32_t timeout_ms = m_timeouts_[(int)type].load();
+    if (timeout_ms == 0)
+        return;
+
+    const uint64_t now = Reactor::NowMs();
+    uint64_t since = now;
+
+    switch (type) {
+        case TimeoutType::kSendStall: {
+            // sendable again
+            if (m_send_flag_.load())
+                return;
+            // waiting for the source of a relay, not for the peer
+            {
+                std::unique_lock<std::mutex> lck(m_send_buff_mtx_);
+                if (m_relay_wait_fd_ >= 0)
+                    return;
+            }
+            // count from the later one of stall beginning and the last successful send
+            const uint64_t stall_since = m_stall_since_ms_.load();
+            const uint64_t last_send = m_last_send_ms_.load();
+            since = stall_since > last_send ? stall_since : last_send;
+            break;
+        }
+        case TimeoutType::kIdle:
+            since = m_last_active_ms_.load();
+            break;
+        case TimeoutType::kRead:
+            // the incomplete message is read already
+            if (!m_read_pending_.load())
+                return;
+            since = now - timeout_ms;
+            break;
+        case TimeoutType::kConnect:
+            // established already
+            if (!m_connecting_.load())
+                return;
+            since = now - timeout_ms;
+            break;
+        default:
+            return;
+    }
+
+    // something happened after arming, arm it again for the rest of time
+    if (now < since + timeout_ms) {
+        m_reactor_->ArmTimer(this, type, since + timeout_ms, false);
+        return;
+    }
+
+    // run timeout function, close connection when it returns true or not set
+    bool close_conn = true;
+    EndpointPtr endpoint = m_endpoint_.lock();
+    if (endpoint != nullptr) {
+        std::function<bool(const ConnectionPtr&, TimeoutType)> timeout_func;
+        {
+            std::unique_lock<std::mutex> lck(endpoint->m_mtx_connptrs_);
+            timeout_func = endpoint->m_timeout_func_;
+        }
+        if (timeout_func)
+            close_conn = timeout_func(shared_from_this(), type);
+    }
+
+    if (close_conn) {
+        switch (type) {
+            case TimeoutType::kSendStall:   Metrics::Add(MetricCounter::kSendStallCloses);  break;
+            case TimeoutType::kIdle:        Metrics::Add(MetricCounter::kIdleCloses);       break;
+            case TimeoutType::kRead:        Metrics::Add(MetricCounter::kReadCloses);       break;
+            default:                        break;
+        }
         CloseConn();
     }
+}
+
+inline void Connection::ResumeRelay() {
+    {
+        std::unique_lock<std::mutex> lck(m_send_buff_mtx_);
+        if (m_relay_wait_fd_ < 0)
+            return;
+        UnwatchRelay();
+    }
 
-    return connect_state && send_flag && m_send_buff_size_ > 0;
+    // the socket is tried again, EPOLLOUT is waited for if it is full
+    SetSendFlag();
+    m_reactor_->ScheduleSend(shared_from_this());
 }
 
-inline int Connection::TrySend() {
-    if (!IsConn())
-        return 0;
+inline void Connection::UnwatchRelay() {
+    if (m_relay_wait_fd_ < 0)
+        return;
+
+    // io_uring polls the source with the send in flight, it is never closed before that completes
+    if (m_reactor_->m_backend_ == Backend::kEpoll)
+        m_reactor_->UnwatchRelay(this, m_relay_wait_fd_);
+    m_relay_wait_fd_ = -1;
+}
 
+inline int Connection::TrySend() {
     int sent = 0;
+    bool drained = false;
+    bool empty = false;
+    bool close = false;
     {
         std::unique_lock<std::mutex> lck(m_send_buff_mtx_);
-        if (m_send_buff_size_ == 0)
-            return -1;
+        // checked under the lock, the reactor closes the fd under it
+        if (!IsConn())
+            return 0;
+        if (m_send_buff_.Empty()) {
+            if (!m_close_drained_)
+                return -1;
+
+            // a half-closed connection has sent everything
+            lck.unlock();
+            CloseConn();
+            return 0;
+        }
+
+        AdaptTransport(Reactor::NowMs());
+
+        // cleared before trying rather than after EAGAIN, so an EPOLLOUT coming while sending is never overwritten
+        m_send_flag_.store(false);
+
+        while (true) {
+            // files and relays are sent without passing through user memory
+            if (m_send_buff_.FrontIsFile()) {
+                // the relay may end and close its source below
+                UnwatchRelay();
+                sent = (int)m_send_buff_.SendFile(m_fd_, m_send_chunk_);
+                if (sent != 0)
+                    break;
 
-        // get the len need to send and copy msg to tmp_buff
-        size_t len = m_send_buff_size_ > 1500 ? 1500 : m_send_buff_size_;
+                // the relay ended early, go on with the next item
+                if (m_send_buff_.Empty()) {
+                    empty = true;
+                    close = m_close_drained_;
+                    drained = CrossLowWatermark();
+                    break;
+                }
+                continue;
+            }
 
-        // send with non-blocking mode
-        sent = send(m_fd_, m_send_buff_, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+            // gather queued messages
+            iovec iov[kMaxIovCount];
+            msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = m_send_buff_.Fill(iov, kMaxIovCount, m_send_chunk_);
+
+            // large sends skip the copy into the kernel, small ones are cheaper to copy than to track
+            bool zerocopy = false;
+            if (m_zerocopy_) {
+                size_t bytes = 0;
+                for (size_t i = 0; i < msg.msg_iovlen; i++)
+                    bytes += iov[i].iov_len;
+                zerocopy = bytes >= m_policy_->m_zerocopy_threshold_;
+            }
+
+            // send with non-blocking mode
+            sent = sendmsg(m_fd_, &msg, MSG_DONTWAIT | MSG_NOSIGNAL | (zerocopy ? MSG_ZEROCOPY : 0));
+            // out of memory to pin pages, copy this time
+            if (sent < 0 && zerocopy && errno == ENOBUFS) {
+                zerocopy = false;
+                sent = sendmsg(m_fd_, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+            }
+
+            if (sent > 0 && zerocopy) {
+                m_send_buff_.ConsumeZeroCopy(sent);
+                Metrics::Add(MetricCounter::kZeroCopySends);
+            }
+            else if (sent > 0) {
+                m_send_buff_.Consume(sent);
+            }
+            break;
+        }
 
         // send done
         if (sent > 0) {
-            m_prev_sendtime_ = time(nullptr);
+            const uint64_t now = Reactor::NowMs();
+            m_last_send_ms_.store(now);
+            m_last_active_ms_.store(now);
+
+            RecordSent(sent);
+            drained = CrossLowWatermark();
+        }
+
+        // still writable, it stays cleared only when the socket is full
+        if (sent > 0 || empty)
+            m_send_flag_.store(true);
 
-            m_send_buff_size_ -= sent;
-            memmove(m_send_buff_, m_send_buff_ + sent, m_send_buff_size_);
-            return sent;
+        // the source of the relay has nothing to read, wait for it instead of EPOLLOUT
+        const int wait_fd = sent < 0 ? m_send_buff_.RelayWaitFd() : -1;
+        if (wait_fd >= 0) {
+            if (!m_reactor_->WatchRelay(shared_from_this(), wait_fd)) {
+                std::cerr << "SafetyTcpConn >> Connection >> Error >> Watch Relay Source Failure | FD: " << wait_fd << std::endl;
+                lck.unlock();
+                CloseConn();
+                return 0;
+            }
+            m_relay_wait_fd_ = wait_fd;
         }
     }
+
+    if (empty) {
+        if (drained)
+            RunWatermarkFunc(false);
+        if (close) {
+            CloseConn();
+            return 0;
+        }
+        return -1;
+    }
+
+    if (sent > 0) {
+        if (drained)
+            RunWatermarkFunc(false);
+        return sent;
+    }
     
     // can't send currently
-    if (sent < 0 && (errno == EAGAIN || errno == EINTR)) {
-        m_send_flag_.store(false);
+    if (sent < 0 && (errno == EAGAIN || errno == EINTR))
         return -1;
-    }
     // disconnected
     else {
         CloseConn();
@@ -0,0 +1,71 @@
+#ifndef STC_CONNECTION_POOL_HPP
+#define STC_CONNECTION_POOL_HPP
+
+#include <iostream>
+#include <mutex>
+#include <deque>
+#include <string>
+
+#include "Classes.hpp"
+#include "Core.hpp"
+#include "TransportPolicy.hpp"
+
+namespace SafetyTcpConn {
+
+/// @brief Warm outbound connections to one destination, connected ahead of time and reused by whoever needs one.
+/// @note All connections of a pool share the same functions and `TransportPolicy`.
+/// A closed idle connection is replaced, a connection that failed to connect is only replaced on the next `Acquire`.
+class ConnectionPool : public std::enable_shared_from_this<ConnectionPool> {
+private:
+    friend class std::shared_ptr<ConnectionPool>;
+
+    Core*                       m_core_;
+    const std::string           m_ip_;
+    const int                   m_port_;
+    const size_t                m_warm_count_;
+    EndpointFuncsPtr            m_funcs_;       // set once by `CreatePool`, the cleanup function refers back to the pool
+    const TransportPolicyPtr    m_policy_;
+
+    std::mutex                  m_mtx_;
+    bool                        m_open_;
+    std::deque<ConnectionPtr>   m_idle_;        // warm connections not in use, established or still connecting
+    size_t                      m_refilling_;   // connects started by `Refill` but not in `m_idle_` yet
+private:
+    ConnectionPool(Core* core, const std::string& ip, int port, size_t warm_count, const TransportPolicy& policy);
+
+public:
+    ~ConnectionPool();
+
+    /// @brief Create a pool and start connecting its warm connections
+    /// @param ip IPv4 address of the destination. example: `127.0.0.1`
+    /// @param warm_count connections kept open and idle
+    /// @param coninit_func function like `void(const ConnectionPtr& conn)`, runs once a connection is established
+    /// @param policy send / recv sizes, socket options and timeouts of the connections
+    static ConnectionPoolPtr CreatePool(Core* core, const std::string& ip, int port, size_t warm_count,
+        ConnectionFunc coninit_func, ConnectionFunc process_func, ConnectionFunc cleanup_func, const TransportPolicy& policy = TransportPolicy());
+
+    /// @brief Take a warm connection, an established one first, and start connecting its replacement
+    /// @return `ConnectionPtr`: a connection, a new one when none is warm / `nullptr` when the pool is closed or the connect fails at once
+    /// @note The connection may still be connecting, messages enqueued now are sent once established.
+    ConnectionPtr Acquire();
+
+    /// @brief Give a connection back for reuse, it is closed when the pool has enough idle ones already
+    void Release(const ConnectionPtr& conn);
+
+    /// @brief Get the count of idle connections, including those still connecting
+    size_t IdleCount();
+
+    /// @brief Close all idle connections and stop connecting, acquired connections stay open
+    void ClosePool();
+
+private:
+    /// @brief Connect until there are `m_warm_count_` idle connections
+    void Refill();
+
+    /// @brief Forget a closed connection, and replace it if it was an established idle one
+    void Remove(const ConnectionPtr& conn);
+};
+
+}
+
+#endif
\ No newline at end of file
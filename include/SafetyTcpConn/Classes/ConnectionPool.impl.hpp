@@ -0,0 +1,162 @@
+#ifndef STC_CONNECTION_POOL_FUNC_HPP
+#define STC_CONNECTION_POOL_FUNC_HPP
+
+#include "Classes.hpp"
+#include "ConnectionPool.hpp"
+#include "Connection.hpp"
+#include "Endpoint.hpp"
+
+namespace SafetyTcpConn {
+
+ConnectionPool::ConnectionPool(Core* core, const std::string& ip, int port, size_t warm_count, const TransportPolicy& policy) :
+    m_core_(core), m_ip_(ip), m_port_(port), m_warm_count_(warm_count),
+    m_policy_(std::make_shared<TransportPolicy>(policy)),
+    m_open_(true), m_refilling_(0)
+{
+    std::cout << "SafetyTcpConn >> ConnectionPool >> Start | Destination: " << m_ip_ << ":" << m_port_ << " | Warm Count: " << m_warm_count_ << std::endl;
+}
+
+ConnectionPool::~ConnectionPool() {
+    ClosePool();
+    std::cout << "SafetyTcpConn >> ConnectionPool >> Safety Clean | Destination: " << m_ip_ << ":" << m_port_ << std::endl;
+}
+
+inline ConnectionPoolPtr ConnectionPool::CreatePool(Core* core, const std::string& ip, int port, size_t warm_count,
+    ConnectionFunc coninit_func, ConnectionFunc process_func, ConnectionFunc cleanup_func, const TransportPolicy& policy) {
+    ConnectionPoolPtr pool = std::shared_ptr<ConnectionPool>(
+        new ConnectionPool(core, ip, port, warm_count, policy)
+    );
+
+    // connections only refer to the pool weakly, a pool is released while its connections are in use
+    std::weak_ptr<ConnectionPool> weak_pool = pool;
+    pool->m_funcs_ = std::make_shared<EndpointFuncs>(std::move(coninit_func), std::move(process_func),
+        [weak_pool, cleanup_func](const ConnectionPtr& conn) {
+            cleanup_func(conn);
+
+            ConnectionPoolPtr pool = weak_pool.lock();
+            if (pool != nullptr)
+                pool->Remove(conn);
+        }
+    );
+
+    pool->Refill();
+    return pool;
+}
+
+inline ConnectionPtr ConnectionPool::Acquire() {
+    ConnectionPtr conn;
+    {
+        std::unique_lock<std::mutex> lck(m_mtx_);
+        if (!m_open_)
+            return nullptr;
+
+        // established ones first, then the oldest one still connecting, closed ones are removed by their cleanup function
+        for (auto it = m_idle_.begin(); it != m_idle_.end(); it++) {
+            if ((*it)->IsConn() && !(*it)->IsConnecting()) {
+                conn = *it;
+                m_idle_.erase(it);
+                break;
+            }
+        }
+        for (auto it = m_idle_.begin(); conn == nullptr && it != m_idle_.end(); it++) {
+            if ((*it)->IsConn()) {
+                conn = *it;
+                m_idle_.erase(it);
+                break;
+            }
+        }
+    }
+
+    // none is warm, connect one for this caller
+    if (conn == nullptr)
+        conn = m_core_->Connect(m_ip_, m_port_, m_funcs_, m_policy_);
+
+    Refill();
+    return conn;
+}
+
+inline void ConnectionPool::Release(const ConnectionPtr& conn) {
+    // not a connection of this pool
+    if (conn == nullptr || conn->m_funcs_ != m_funcs_)
+        return;
+
+    {
+        std::unique_lock<std::mutex> lck(m_mtx_);
+        if (m_open_ && conn->IsConn() && m_idle_.size() < m_warm_count_) {
+            for (size_t i = 0; i < m_idle_.size(); i++)
+                if (m_idle_[i] == conn)
+                    return;
+            m_idle_.push_back(conn);
+            return;
+        }
+    }
+
+    conn->CloseConn();
+}
+
+inline size_t ConnectionPool::IdleCount() {
+    std::unique_lock<std::mutex> lck(m_mtx_);
+    return m_idle_.size();
+}
+
+inline void ConnectionPool::ClosePool() {
+    std::deque<ConnectionPtr> idle;
+    {
+        std::unique_lock<std::mutex> lck(m_mtx_);
+        if (!m_open_)
+            return;
+        m_open_ = false;
+        idle.swap(m_idle_);
+    }
+
+    for (size_t i = 0; i < idle.size(); i++)
+        idle[i]->CloseConn();
+}
+
+inline void ConnectionPool::Refill() {
+    // claim the missing slots first, so concurrent refills don't connect the same slot twice
+    size_t count = 0;
+    {
+        std::unique_lock<std::mutex> lck(m_mtx_);
+        if (!m_open_ || m_idle_.size() + m_refilling_ >= m_warm_count_)
+            return;
+        count = m_warm_count_ - m_idle_.size() - m_refilling_;
+        m_refilling_ += count;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        ConnectionPtr conn = m_core_->Connect(m_ip_, m_port_, m_funcs_, m_policy_);
+
+        std::unique_lock<std::mutex> lck(m_mtx_);
+        m_refilling_--;
+        // closed already, its cleanup function may have run before it is here
+        if (conn == nullptr || !conn->IsConn())
+            continue;
+        if (m_open_)
+            m_idle_.push_back(conn);
+        else
+            conn->CloseConn();
+    }
+}
+
+inline void ConnectionPool::Remove(const ConnectionPtr& conn) {
+    bool replace = false;
+    {
+        std::unique_lock<std::mutex> lck(m_mtx_);
+        for (auto it = m_idle_.begin(); it != m_idle_.end(); it++) {
+            if (*it == conn) {
+                m_idle_.erase(it);
+                // a failed connect is not retried here, or an unreachable destination would be retried without a pause
+                replace = m_open_ && !conn->IsConnecting();
+                break;
+            }
+        }
+    }
+
+    if (replace)
+        Refill();
+}
+
+}
+
+#endif
\ No newline at end of file
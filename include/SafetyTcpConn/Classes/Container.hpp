@@ -13,8 +13,9 @@ enum class ContainerType {
 class Container {
 public:
     const ContainerType m_type_;
+    Reactor*            m_reactor_;
 
-    Container(ContainerType type) : m_type_(type) {};
+    Container(ContainerType type) : m_type_(type), m_reactor_(nullptr) {};
     virtual ~Container() {};
 };
 
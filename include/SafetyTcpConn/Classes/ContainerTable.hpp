@@ -0,0 +1,73 @@
+#ifndef STC_CONTAINER_TABLE_HPP
+#define STC_CONTAINER_TABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "Classes.hpp"
+#include "Container.hpp"
+
+namespace SafetyTcpConn {
+
+/// @brief Containers of a reactor indexed by fd, for looking up the container of an event without locking.
+/// @note Inserting and removing lock a mutex, looking up doesn't, and only the loop thread of the reactor looks up.
+/// Every insert gets a key of the fd and a generation of its slot, an event carrying the key of a removed container
+/// never finds the new container which reuses the fd.
+/// Removed containers are kept alive until the loop thread calls `Reclaim`, so a pointer it found stays valid until then.
+class ContainerTable {
+private:
+    static constexpr int    kChunkBits  = 12;
+    static constexpr int    kChunkSize  = 1 << kChunkBits;
+    static constexpr int    kMaxChunks  = 1024;     // up to 4M fds
+
+    struct Slot {
+        std::atomic<uint32_t>   m_generation_;
+        std::atomic<Container*> m_container_;   // for looking up
+        ContainerPtr            m_owner_;       // guarded by `m_mtx_`
+
+        Slot() : m_generation_(0), m_container_(nullptr) {};
+    };
+
+    std::mutex                  m_mtx_;
+    // chunks are allocated on the first fd in their range and never moved, so looking up needs no lock
+    std::atomic<Slot*>          m_chunks_[kMaxChunks];
+    std::vector<ContainerPtr>   m_retired_;     // removed, released by `Reclaim`, guarded by `m_mtx_`
+public:
+    ContainerTable();
+    ~ContainerTable();
+
+    ContainerTable(const ContainerTable&) = delete;
+    ContainerTable& operator=(const ContainerTable&) = delete;
+
+    /// @brief Put a container at its fd, the previous container of the fd is removed
+    /// @return `uint64_t`: key for `Find`, generation in the high 32 bits and fd in the low 32 bits / `0` when the fd is out of range
+    uint64_t Insert(const int fd, const ContainerPtr& container);
+
+    /// @brief Remove the container at `fd`
+    /// @param expected only remove when the fd still belongs to this container, `nullptr` for any
+    /// @return `ContainerPtr`: the removed container / `nullptr` when not found
+    ContainerPtr Remove(const int fd, const Container* expected = nullptr);
+
+    /// @brief Look up the container of a key without locking, only for the loop thread
+    /// @return `Container*`: the container / `nullptr` when it is removed, valid until `Reclaim`
+    Container* Find(const uint64_t key) const;
+
+    /// @brief Release removed containers, only for the loop thread, when it holds no pointer from `Find`
+    void Reclaim();
+
+private:
+    /// @brief Get the slot of `fd`
+    /// @return `Slot*`: the slot / `nullptr` when the fd is out of range or its chunk isn't allocated
+    Slot* GetSlot(const int fd) const;
+
+    /// @brief Get the slot of `fd`, allocate its chunk if needed, `m_mtx_` must be locked
+    /// @return `Slot*`: the slot / `nullptr` when the fd is out of range
+    Slot* CreateSlot(const int fd);
+};
+
+}
+
+#endif
\ No newline at end of file
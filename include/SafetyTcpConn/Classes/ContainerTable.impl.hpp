@@ -0,0 +1,103 @@
+#ifndef STC_CONTAINER_TABLE_FUNC_HPP
+#define STC_CONTAINER_TABLE_FUNC_HPP
+
+#include "ContainerTable.hpp"
+
+namespace SafetyTcpConn {
+
+ContainerTable::ContainerTable() {
+    for (int i = 0; i < kMaxChunks; i++)
+        m_chunks_[i].store(nullptr);
+}
+
+ContainerTable::~ContainerTable() {
+    for (int i = 0; i < kMaxChunks; i++)
+        delete[] m_chunks_[i].load();
+}
+
+inline uint64_t ContainerTable::Insert(const int fd, const ContainerPtr& container) {
+    std::unique_lock<std::mutex> lck(m_mtx_);
+    Slot* slot = CreateSlot(fd);
+    if (slot == nullptr)
+        return 0;
+
+    if (slot->m_owner_ != nullptr)
+        m_retired_.push_back(std::move(slot->m_owner_));
+
+    // a new generation before the container shows up, the keys of the previous one never match again
+    const uint32_t generation = slot->m_generation_.load() + 1;
+    slot->m_generation_.store(generation);
+    slot->m_owner_ = container;
+    slot->m_container_.store(container.get());
+
+    return ((uint64_t)generation << 32) | (uint32_t)fd;
+}
+
+inline ContainerPtr ContainerTable::Remove(const int fd, const Container* expected) {
+    std::unique_lock<std::mutex> lck(m_mtx_);
+    Slot* slot = GetSlot(fd);
+    if (slot == nullptr || slot->m_owner_ == nullptr)
+        return nullptr;
+
+    // the fd is reused by another container already
+    if (expected != nullptr && slot->m_owner_.get() != expected)
+        return nullptr;
+
+    // hide it first, then end its generation
+    slot->m_container_.store(nullptr);
+    slot->m_generation_.store(slot->m_generation_.load() + 1);
+
+    // the loop thread may be using it right now
+    ContainerPtr container = std::move(slot->m_owner_);
+    m_retired_.push_back(container);
+    return container;
+}
+
+inline Container* ContainerTable::Find(const uint64_t key) const {
+    Slot* slot = GetSlot((int)(uint32_t)key);
+    if (slot == nullptr)
+        return nullptr;
+
+    // the generation is checked after loading the pointer, a pointer of a removed container fails the check
+    Container* container = slot->m_container_.load();
+    if (slot->m_generation_.load() != (uint32_t)(key >> 32))
+        return nullptr;
+    return container;
+}
+
+inline void ContainerTable::Reclaim() {
+    std::vector<ContainerPtr> retired;
+    {
+        std::unique_lock<std::mutex> lck(m_mtx_);
+        if (m_retired_.empty())
+            return;
+        retired.swap(m_retired_);
+    }
+    // released here, outside the lock
+}
+
+inline ContainerTable::Slot* ContainerTable::GetSlot(const int fd) const {
+    if (fd < 0 || (fd >> kChunkBits) >= kMaxChunks)
+        return nullptr;
+
+    Slot* slots = m_chunks_[fd >> kChunkBits].load();
+    return slots != nullptr ? &slots[fd & (kChunkSize - 1)] : nullptr;
+}
+
+inline ContainerTable::Slot* ContainerTable::CreateSlot(const int fd) {
+    if (fd < 0 || (fd >> kChunkBits) >= kMaxChunks)
+        return nullptr;
+
+    // published after the slots are constructed
+    Slot* slots = m_chunks_[fd >> kChunkBits].load();
+    if (slots == nullptr) {
+        slots = new Slot[kChunkSize];
+        m_chunks_[fd >> kChunkBits].store(slots);
+    }
+
+    return &slots[fd & (kChunkSize - 1)];
+}
+
+}
+
+#endif
\ No newline at end of file
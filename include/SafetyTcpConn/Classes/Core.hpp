@@ -7,39 +7,66 @@
 #include <atomic>
 #include <condition_variable>
 #include <functional>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "Classes.hpp"
+#include "TransportPolicy.hpp"
 
 namespace SafetyTcpConn {
 
+/// @brief I/O backend of reactors
+enum class Backend {
+    kEpoll,     // readiness by epoll, recv / sendmsg by the epoll thread and the send thread
+    kIoUring    // completions by io_uring (Linux 6.0+), multishot accept / recv and batched sendmsg, falls back to epoll when not supported
+};
+
 class Core {
 private:
+    friend class Reactor;
     friend class Endpoint;
     friend class Connection;
+    friend class ConnectionPool;
 
-    std::atomic_bool m_open_;
-
-    int m_epoll_fd_;
-    std::thread m_epoll_thread_;
-    std::thread m_send_thread_;
-
-    std::mutex m_mtx_containers_;
-    std::condition_variable m_cond_containers_;
-    std::unordered_map<int, ContainerPtr> m_fd_2_containers_;
+    std::vector<Reactor*>   m_reactors_;
+    std::atomic_size_t      m_next_reactor_;
+    WorkerPool*             m_workers_;     // nullptr when process functions run on reactors
 public:
-    Core();
+    /// @brief Create a core with `reactor_count` reactors, each one owns an epoll fd, an epoll thread and a send thread
+    /// @param reactor_count number of reactors, accepted connections are spread across them. example: `std::thread::hardware_concurrency()`
+    /// @param backend I/O backend of reactors, `Backend::kIoUring` needs Linux 6.0+ and falls back to `Backend::kEpoll` when not supported
+    /// @param worker_count number of worker threads for process functions, `0` to run them on the reactor threads.
+    /// use workers when process functions may block, e.g. database lookups, a connection is still processed by one worker at a time
+    Core(size_t reactor_count = 1, Backend backend = Backend::kEpoll, size_t worker_count = 0);
     ~Core();
 
-private:
-    void RegisterContainer(ContainerPtr& container);
-    void UnregisterContainer(const int container_fd);
+    /// @brief Get the number of reactors in this core
+    /// @return `size_t`: reactor count
+    size_t ReactorCount();
+
+    /// @brief Get the number of worker threads in this core
+    /// @return `size_t`: worker count, `0` when process functions run on the reactor threads
+    size_t WorkerCount();
 
-    void StartTrySend();
+    /// @brief Open an outbound connection with non-blocking connect, it is served by a reactor like an accepted one
+    /// @param ip IPv4 address of the destination. example: `127.0.0.1`
+    /// @param coninit_func function like `void(const ConnectionPtr& conn)`, runs once the connection is established
+    /// @param policy send / recv sizes, socket options and timeouts, `m_connect_timeout_ms_` limits the connect
+    /// @return `ConnectionPtr`: the connection, still connecting / `nullptr` when the address is invalid or the connect fails at once
+    /// @note Messages can be enqueued while connecting, they are sent once established.
+    /// `cleanup_func` runs for every returned connection, `IsConnecting()` is still `true` in it when the connect failed or timed out.
+    ConnectionPtr Connect(const std::string& ip, int port, ConnectionFunc coninit_func, ConnectionFunc process_func, ConnectionFunc cleanup_func,
+        const TransportPolicy& policy = TransportPolicy());
 
 private:
-    static void EpollLoop(Core* core);
-    static void SendLoop(Core* core);
+    /// @brief Same as the public one, with functions and policy shared by other connections
+    ConnectionPtr Connect(const std::string& ip, int port, const EndpointFuncsPtr& funcs, const TransportPolicyPtr& policy);
+
+    void RegisterContainer(ContainerPtr& container);
+
+    /// @brief Pick the reactor which currently holds the fewest connections, ties are broken in round-robin order
+    Reactor* NextReactor();
 };
 
 }
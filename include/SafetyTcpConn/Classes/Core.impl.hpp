@@ -1,251 +1,128 @@
 #ifndef SFC_CORE_FUNC_HPP
 #define SFC_CORE_FUNC_HPP
 
-#include <sys/epoll.h>
+#include <arpa/inet.h>
 
 #include "Classes.hpp"
 #include "Core.hpp"
+#include "Reactor.hpp"
+#include "WorkerPool.hpp"
 #include "Endpoint.hpp"
 
 namespace SafetyTcpConn {
 
-Core::Core() : m_open_(true) {
-    if ((m_epoll_fd_ = epoll_create(1)) == -1) {
-        std::cout << "SafetyTcpConn >> Core >> Error >> Can't create Epoll" << std::endl;
-        exit(EXIT_FAILURE);
-    }
+Core::Core(size_t reactor_count, Backend backend, size_t worker_count) : m_next_reactor_(0), m_workers_(nullptr) {
+    if (reactor_count == 0)
+        reactor_count = 1;
+
+    // workers are ready before any reactor hands them a connection
+    if (worker_count > 0)
+        m_workers_ = new WorkerPool(worker_count);
+
+    for (size_t i = 0; i < reactor_count; i++)
+        m_reactors_.push_back(new Reactor(this, i, backend));
 
-    std::cout << "SafetyTcpConn >> Core >> Epoll Create Success | Epoll FD: " << m_epoll_fd_ << std::endl;
-    m_epoll_thread_ = std::thread(EpollLoop, this);
-    m_send_thread_ = std::thread(SendLoop, this);
+    std::cout << "SafetyTcpConn >> Core >> Start | Reactor Count: " << m_reactors_.size() << std::endl;
 }
 
 Core::~Core() {
-    m_open_.store(false);
+    // stop all reactors before releasing any of them, a reactor may still hand connections to another one
+    for (size_t i = 0; i < m_reactors_.size(); i++)
+        m_reactors_[i]->m_open_.store(false);
+    for (size_t i = 0; i < m_reactors_.size(); i++)
+        m_reactors_[i]->Stop();
+
+    // finish queued process functions while reactors still exist, they may enqueue messages
+    if (m_workers_ != nullptr) {
+        delete m_workers_;
+        m_workers_ = nullptr;
+    }
 
-    // wake up send thread
-    StartTrySend();
+    for (size_t i = 0; i < m_reactors_.size(); i++)
+        delete m_reactors_[i];
+    m_reactors_.clear();
 
-    m_epoll_thread_.join();
-    m_send_thread_.join();
+    std::cout << "SafetyTcpConn >> Core >> Safety Clean" << std::endl;
+}
 
-    std::cout << "SafetyTcpConn >> Core >> Safety Clean | Epoll FD: " << m_epoll_fd_ << std::endl;
+inline size_t Core::ReactorCount() {
+    return m_reactors_.size();
 }
 
-void Core::RegisterContainer(ContainerPtr& container) {
-    if (container.get() == nullptr)
-        return;
+inline size_t Core::WorkerCount() {
+    return m_workers_ == nullptr ? 0 : m_workers_->WorkerCount();
+}
 
-    if (container->m_type_ == ContainerType::kEndpoint) {
-        EndpointPtr endpoint = std::static_pointer_cast<Endpoint>(container);
+inline ConnectionPtr Core::Connect(const std::string& ip, int port, ConnectionFunc coninit_func, ConnectionFunc process_func, ConnectionFunc cleanup_func,
+    const TransportPolicy& policy) {
+    return Connect(ip, port,
+        std::make_shared<EndpointFuncs>(std::move(coninit_func), std::move(process_func), std::move(cleanup_func)),
+        std::make_shared<TransportPolicy>(policy)
+    );
+}
 
-        {
-            std::unique_lock<std::mutex> lck(m_mtx_containers_);
-            m_fd_2_containers_[endpoint->m_fd_] = container;
-        }
+inline ConnectionPtr Core::Connect(const std::string& ip, int port, const EndpointFuncsPtr& funcs, const TransportPolicyPtr& policy) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (port < 1 || port > 65535 || inet_pton(AF_INET, ip.c_str(), &addr.sin_addr) != 1) {
+        std::cerr << "SafetyTcpConn >> Core >> Error >> Address: " << ip << ":" << port << " is not Avaliable." << std::endl;
+        return nullptr;
+    }
 
-        epoll_event event{};
-        event.events = EPOLLIN;
-        event.data.fd = endpoint->m_fd_;
-        epoll_ctl(m_epoll_fd_, EPOLL_CTL_ADD, endpoint->m_fd_, &event);
+    // create socket, non-blocking so that connecting never blocks the caller
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+    if (fd < 0) {
+        std::cerr << "SafetyTcpConn >> Core >> Error >> Socket Create Failure." << std::endl;
+        return nullptr;
     }
-    else {
-        ConnectionPtr conn = std::static_pointer_cast<Connection>(container);
-
-        // add into connection ptr map
-        {
-            std::unique_lock<std::mutex> lck(m_mtx_containers_);
-            m_fd_2_containers_[conn->m_fd_] = container;
-        }
-
-        // epoll subscribe to client
-        epoll_event client_event{};
-        client_event.events = EPOLLIN | EPOLLOUT | EPOLLERR | EPOLLHUP | EPOLLRDHUP | EPOLLET;
-        client_event.data.fd = conn->m_fd_;
-        epoll_ctl(m_epoll_fd_, EPOLL_CTL_ADD, conn->m_fd_, &client_event);
-
-        // run connection init function
-        conn->m_coninit_func_(conn);
+
+    // usually in progress, the reactor finishes it when the socket becomes writable
+    if (connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+        close(fd);
+        Metrics::Add(MetricCounter::kConnectFailures);
+        return nullptr;
     }
-}
 
-void Core::UnregisterContainer(const int container_fd) {
-    ContainerPtr container = nullptr;
-    {
-        std::unique_lock<std::mutex> lck(m_mtx_containers_);
-        // try get container ptr
-        auto it = m_fd_2_containers_.find(container_fd);
-        if (it == m_fd_2_containers_.end())
-            return;
+    // even a connect done at once is finished by the reactor, so init function always runs there
+    ConnectionPtr conn = std::allocate_shared<Connection>(PoolAllocator<Connection>(), fd, this, funcs, policy, true);
+    ContainerPtr container = conn;
+    RegisterContainer(container);
 
-        container = it->second;
+    return conn;
+}
 
-        // remove from connection ptr map
-        m_fd_2_containers_.erase(it);
-    }
+inline void Core::RegisterContainer(ContainerPtr& container) {
+    if (container.get() == nullptr)
+        return;
 
     if (container->m_type_ == ContainerType::kEndpoint) {
         EndpointPtr endpoint = std::static_pointer_cast<Endpoint>(container);
 
-        // unsubscribe from epoll
-        epoll_ctl(m_epoll_fd_, EPOLL_CTL_DEL, endpoint->m_fd_, nullptr);
-    }
-    else {
-        ConnectionPtr conn = std::static_pointer_cast<Connection>(container);
-        
-        // unsubscribe from epoll
-        epoll_ctl(m_epoll_fd_, EPOLL_CTL_DEL, conn->m_fd_, nullptr);
-
-        // remove from endpoint
-        EndpointPtr endpoint = conn->m_endpoint_.lock();
-        if (endpoint != nullptr) // ready for client mode
-            Endpoint::Remove(endpoint, conn->m_fd_);
-        
-        // close connection and run cleanup function
-        conn->CloseConn();
-        conn->m_cleanup_func_(conn);
+        // one listener per reactor, starting from the next one in round-robin order
+        const size_t start = m_next_reactor_.fetch_add(1);
+        for (size_t i = 0; i < endpoint->m_listeners_.size(); i++)
+            endpoint->m_listeners_[i].m_reactor_ = m_reactors_[(start + i) % m_reactors_.size()];
+        for (size_t i = 0; i < endpoint->m_listeners_.size(); i++)
+            endpoint->m_listeners_[i].m_reactor_->RegisterContainer(container);
+        return;
     }
-}
 
-inline void Core::StartTrySend() {
-    std::unique_lock<std::mutex> lck(m_mtx_containers_);
-    m_cond_containers_.notify_one();
+    NextReactor()->RegisterContainer(container);
 }
 
-inline void Core::EpollLoop(Core* core) {
-    constexpr int kMaxEventSize = 32;
-    epoll_event epoll_events[kMaxEventSize];
-
-    int event_count = 0;
-    while (core->m_open_.load()) {
-        if ((event_count = epoll_wait(core->m_epoll_fd_, epoll_events, kMaxEventSize, 1000)) == -1) {
-            std::cerr << "SafetyTcpConn >> Endpoint >> Error >> Epoll Error!" << std::endl;
-            exit(EXIT_FAILURE);
-        }
-
-        // scan and remove locally closed connection
-        {
-            // find all locally closed connection
-            std::vector<ConnectionPtr> locally_closed_connections;
-            for (auto it = core->m_fd_2_containers_.begin(); it != core->m_fd_2_containers_.end(); it++) {
-                ContainerPtr& container = it->second;
-                if (container->m_type_!=ContainerType::kConnection)
-                    continue;
-                ConnectionPtr conn = std::static_pointer_cast<Connection>(container);
-                if (conn->IsConn())
-                    continue;
-                locally_closed_connections.push_back(conn);
-            }
-
-            // run normal cleanup funtion
-            for (int i = 0; i < locally_closed_connections.size(); i++) {
-                ConnectionPtr& conn = locally_closed_connections.at(i);
-                core->UnregisterContainer(conn->m_fd_);
-            }
-        }
-
-        for (int i = 0; i < event_count; i++) {
-            const int target_fd = epoll_events[i].data.fd;
-
-            // get container from container map
-            ContainerPtr container;
-            {
-                std::unique_lock<std::mutex> lck(core->m_mtx_containers_);
-                auto it_containers = core->m_fd_2_containers_.find(target_fd);
-
-                // container found
-                if (it_containers == core->m_fd_2_containers_.end())
-                    continue;
-                container = it_containers->second;
-            }
-
-            // endpoint found, accept connection
-            if (container->m_type_ == ContainerType::kEndpoint) {
-                EndpointPtr endpoint = std::static_pointer_cast<Endpoint>(container);
-
-                ContainerPtr conn = Endpoint::Accept(endpoint);
-                core->RegisterContainer(conn);
-            }
-            // connection found
-            else {
-                ConnectionPtr conn = std::static_pointer_cast<Connection>(container);
-
-                // error or connection closed
-                if (epoll_events[i].events & EPOLLERR || epoll_events[i].events & EPOLLHUP || epoll_events[i].events & EPOLLRDHUP) {
-                    core->UnregisterContainer(target_fd);
-                }
-                // data receive
-                else if (epoll_events[i].events & EPOLLIN) {
-                    // connection receive message
-                    if (conn->TryRecv()) {
-                        // run process function
-                        conn->m_process_func_(conn);
-                    }
-                }
-                // available to send
-                else if (epoll_events[i].events & EPOLLOUT) {
-                    conn->SetSendFlag();
-                    core->StartTrySend();
-                }
-            }
-        }
-    }
-
-    std::cout << "SafetyTcpConn >> Core >> Epoll Thread Ended | Epoll FD: " << core->m_epoll_fd_ << std::endl;
-}
+inline Reactor* Core::NextReactor() {
+    const size_t reactor_count = m_reactors_.size();
+    const size_t start = m_next_reactor_.fetch_add(1) % reactor_count;
 
-inline void Core::SendLoop(Core* core) {
-    std::unordered_set<ConnectionPtr> need_to_send;
-    std::unordered_set<ConnectionPtr> no_need_to_send;
-
-    while (core->m_open_.load()) {
-        // update need_to_send set
-        {
-            std::unique_lock<std::mutex> lck(core->m_mtx_containers_);
-
-            start_update_set:
-            for (auto it = core->m_fd_2_containers_.begin(); it != core->m_fd_2_containers_.end(); it++) {
-                const ContainerPtr& container = it->second;
-                if (container->m_type_ != ContainerType::kConnection)
-                    continue;
-                ConnectionPtr conn = std::static_pointer_cast<Connection>(container);
-                if (conn->NeedSend() && need_to_send.find(conn) == need_to_send.end())
-                    need_to_send.emplace(conn);
-            }
-
-            // nothing need to send, wait
-            if (need_to_send.size() == 0) {
-                core->m_cond_containers_.wait_for(lck, std::chrono::milliseconds(1));
-                if (!core->m_open_.load())
-                    break;
-                goto start_update_set; // this can save time on unlocking and relocking
-            }
-        }
-
-        // call TrySend for connections in need_to_send set
-        for (auto it = need_to_send.begin(); it != need_to_send.end(); it++) {
-            const ConnectionPtr& conn = *it;
-            
-            // sent messages until can't send
-            int quota = 10; // fair usage policy
-            while (quota-- > 0) {
-                // keep send data until can't send or reach the limit
-                if (conn->TrySend() > 0) continue;
-
-                // when connection is unable to send data, put it into the no_need_to_send set
-                // it will removed from the need_to_send set after all connections have sent their data
-                no_need_to_send.emplace(conn);
-                break;
-            }
-        }
-
-        // remove no_need_to_send connection from need_to_send set
-        for (auto it = no_need_to_send.begin(); it != no_need_to_send.end(); it++)
-            need_to_send.erase(*it);
-        no_need_to_send.clear();
+    Reactor* target = m_reactors_[start];
+    for (size_t i = 1; i < reactor_count; i++) {
+        Reactor* reactor = m_reactors_[(start + i) % reactor_count];
+        if (reactor->m_conn_count_.load() < target->m_conn_count_.load())
+            target = reactor;
     }
 
-    std::cout << "SafetyTcpConn >> Core >> Send Thread Ended | Epoll FD: " << core->m_epoll_fd_ << std::endl;
+    return target;
 }
 
 }
@@ -11,19 +11,45 @@
 #include <unordered_map>
 #include <unordered_set>
 
+#include <fcntl.h>
+
 #include "Classes.hpp"
 #include "Core.hpp"
 #include "Container.hpp"
 #include "Connection.hpp"
+#include "TransportPolicy.hpp"
+#include "TimerWheel.hpp"
 
 namespace SafetyTcpConn {
 
-class Endpoint : public Container {
+/// @brief Options of the listening sockets of an endpoint
+class ListenOptions {
+public:
+    int     m_backlog_;         // length of the accept queue of each listener, the kernel caps it by net.core.somaxconn
+    size_t  m_listener_count_;  // listeners bound to the same port with SO_REUSEPORT, one per reactor at most, the kernel spreads new connections across them
+
+    ListenOptions() : m_backlog_(SOMAXCONN), m_listener_count_(1) {};
+};
+
+/// @brief Functions of an endpoint, shared by all of its connections instead of being copied into each one
+class EndpointFuncs {
+public:
+    const ConnectionFunc    m_coninit_func_;
+    const ConnectionFunc    m_process_func_;
+    const ConnectionFunc    m_cleanup_func_;
+
+    EndpointFuncs(ConnectionFunc coninit_func, ConnectionFunc process_func, ConnectionFunc cleanup_func);
+};
+
+class Endpoint : public Container, public std::enable_shared_from_this<Endpoint> {
 private:
     friend class Core;
+    friend class Reactor;
     friend class Connection;
     friend class std::shared_ptr<Endpoint>;
 
+    static constexpr int kMaxAcceptCount = 256;
+
     std::atomic_bool                        m_open_;
     Core*                                   m_core_;
     const int                               m_port_;
@@ -31,14 +57,32 @@ private:
 
     sockaddr_in                             m_sockaddr_;
 
-    const std::function<void(ConnectionPtr)>    m_coninit_func_;
-    const std::function<void(ConnectionPtr)>    m_process_func_;
-    const std::function<void(ConnectionPtr)>    m_cleanup_func_;
+    // listening sockets, the first one is `m_fd_`, each one is watched by its own reactor
+    class Listener {
+    public:
+        int         m_fd_;
+        Reactor*    m_reactor_;
+    };
+    std::vector<Listener>                   m_listeners_;
+
+    // an fd kept open on /dev/null, given back to accept and drop a connection when out of fds
+    std::mutex                              m_reserve_mtx_;
+    int                                     m_reserve_fd_;
+
+    const EndpointFuncsPtr                  m_funcs_;
+    const TransportPolicyPtr                m_policy_;
 
     std::mutex                              m_mtx_connptrs_;
     std::unordered_map<int, ConnectionPtr>  m_fd_2_connptrs_;
+
+    std::atomic<uint32_t>                                   m_timeouts_[(int)TimeoutType::kCount];
+    std::function<bool(const ConnectionPtr&, TimeoutType)>  m_timeout_func_;    // guarded by m_mtx_connptrs_
+
+    // guarded by m_mtx_connptrs_
+    ConnectionFunc                          m_high_watermark_func_;
+    ConnectionFunc                          m_drained_func_;
 private:
-    Endpoint(Core* core, int port, std::function<void(ConnectionPtr)> coninit_func, std::function<void(ConnectionPtr)> process_func, std::function<void(ConnectionPtr)> cleanup_func);
+    Endpoint(Core* core, int port, ConnectionFunc coninit_func, ConnectionFunc process_func, ConnectionFunc cleanup_func, const TransportPolicy& policy, const ListenOptions& options);
 
 public:
     ~Endpoint();
@@ -46,9 +90,68 @@ public:
     bool IsOpen();
     void CloseEndpoint();
 
-    static EndpointPtr CreateEndpoint(Core* core, int port, std::function<void(ConnectionPtr)> coninit_func, std::function<void(ConnectionPtr)> process_func, std::function<void(ConnectionPtr)> cleanup_func);
+    /// @brief Set a timeout for connections accepted afterwards
+    /// @param type which timeout to set. default: `kSendStall` from `TransportPolicy` (5000 ms), `kIdle` and `kRead` disabled
+    /// @param timeout_ms timeout in milliseconds, `0` to disable
+    void SetTimeout(const TimeoutType type, const uint32_t timeout_ms);
+
+    /// @brief Set the function to run when a connection of this endpoint is timeout
+    /// @param timeout_func function like `bool(const ConnectionPtr& conn, TimeoutType type)`, return `true` to close the connection
+    /// @note Connections are closed directly on timeout when no timeout function is set.
+    void SetTimeoutFunc(std::function<bool(const ConnectionPtr&, TimeoutType)> timeout_func);
+
+    /// @brief Set the function to run when the bytes waiting to be sent by a connection reach its high watermark
+    /// @param high_watermark_func function like `void(const ConnectionPtr& conn)`, throttle or conflate messages to `conn` from here
+    /// @note It runs on the thread that enqueued the message, once until the drained function runs. Watermarks are set by `TransportPolicy` or `Connection::SetWatermarks`.
+    void SetHighWatermarkFunc(ConnectionFunc high_watermark_func);
+
+    /// @brief Set the function to run when a connection above its high watermark sends down to its low watermark
+    /// @param drained_func function like `void(const ConnectionPtr& conn)`, resume sending to `conn` from here
+    /// @note It runs on the send thread of reactor, keep it short.
+    void SetDrainedFunc(ConnectionFunc drained_func);
+
+    /// @brief Send one message to all connections of this endpoint
+    /// @param msg message you want to send, every connection holds a reference of it instead of a copy
+    /// @return `size_t`: count of connections the message is enqueued to
+    size_t Broadcast(const MessagePtr& msg);
+
+    /// @brief Copy `msg` once and send it to all connections of this endpoint
+    size_t Broadcast(const std::string& msg);
+
+    /// @brief Send one message to the given connections
+    /// @param msg message you want to send, every connection holds a reference of it instead of a copy
+    /// @param conns target connections, they can belong to any endpoint
+    /// @return `size_t`: count of connections the message is enqueued to
+    static size_t Broadcast(const MessagePtr& msg, const std::vector<ConnectionPtr>& conns);
+
+    /// @param policy send / recv sizes, socket options and send stall timeout of the connections. example: `TransportPolicy::LowLatency()`
+    /// @param options backlog and count of listening sockets. default: backlog `SOMAXCONN`, one listener
+    static EndpointPtr CreateEndpoint(Core* core, int port, ConnectionFunc coninit_func, ConnectionFunc process_func, ConnectionFunc cleanup_func,
+        const TransportPolicy& policy = TransportPolicy(), const ListenOptions& options = ListenOptions());
+
+    /// @brief Create an endpoint which splits received data into frames by `codec`
+    /// @param codec a framing codec. example: `DelimiterCodec("\\r\\n")`, `LengthPrefixCodec<uint32_t, Endian::kBig>()`, `VarintCodec<>()`, `FixedSizeCodec<64>()`
+    /// @param frame_func function like `void(const ConnectionPtr& conn, const BufferView& frame)`, runs for every complete frame, the view is only valid inside the function
+    template <typename CodecType, typename FrameFunc>
+    static EndpointPtr CreateEndpoint(Core* core, int port, ConnectionFunc coninit_func, const CodecType& codec, FrameFunc frame_func, ConnectionFunc cleanup_func,
+        const TransportPolicy& policy = TransportPolicy(), const ListenOptions& options = ListenOptions());
 private:
-    static ConnectionPtr Accept(EndpointPtr& endpoint);
+    /// @brief Accept connections from a listener until there is no more, or `kMaxAcceptCount` are accepted, and hand them to reactors
+    /// @note Listeners are level-triggered, connections left are accepted on the next wake up.
+    static void Accept(EndpointPtr& endpoint, int listen_fd);
+
+    /// @brief Get the listener watched by `reactor`
+    /// @return `int`: fd of the listener / `-1` when `reactor` watches none of them
+    int ListenFd(const Reactor* reactor);
+
+    /// @brief Accept the next pending connection with the reserved fd and close it at once, called when accepting fails for out of fds
+    /// @note The connection would stay in the accept queue otherwise, and the level-triggered listener would wake up again at once.
+    /// @return `bool`: a connection dropped(`true`) / none pending or no fd to accept it(`false`)
+    bool DropPending(int listen_fd);
+
+    /// @brief Create a connection instance for a client fd accepted already
+    /// @return `ConnectionPtr`: the connection / `nullptr` when the endpoint is closed
+    static ConnectionPtr Adopt(EndpointPtr& endpoint, int client_fd);
     static void Remove(EndpointPtr& endpoint, int fd);
 };
 
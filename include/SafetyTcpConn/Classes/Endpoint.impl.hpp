@@ -5,11 +5,21 @@
 
 namespace SafetyTcpConn {
 
-Endpoint::Endpoint(Core* core, int port, std::function<void(ConnectionPtr)> coninit_func, std::function<void(ConnectionPtr)> process_func, std::function<void(ConnectionPtr)> cleanup_func) :
+EndpointFuncs::EndpointFuncs(ConnectionFunc coninit_func, ConnectionFunc process_func, ConnectionFunc cleanup_func) :
+    m_coninit_func_(std::move(coninit_func)), m_process_func_(std::move(process_func)), m_cleanup_func_(std::move(cleanup_func))
+{}
+
+Endpoint::Endpoint(Core* core, int port, ConnectionFunc coninit_func, ConnectionFunc process_func, ConnectionFunc cleanup_func, const TransportPolicy& policy, const ListenOptions& options) :
     Container(ContainerType::kEndpoint),
-    m_core_(core), m_port_(port), m_open_(true),
-    m_coninit_func_(coninit_func), m_process_func_(process_func), m_cleanup_func_(cleanup_func)
+    m_open_(true), m_core_(core), m_port_(port), m_reserve_fd_(-1),
+    m_funcs_(std::make_shared<EndpointFuncs>(std::move(coninit_func), std::move(process_func), std::move(cleanup_func))),
+    m_policy_(std::make_shared<TransportPolicy>(policy))
 {
+    m_timeouts_[(int)TimeoutType::kSendStall].store(policy.m_send_stall_timeout_ms_);
+    m_timeouts_[(int)TimeoutType::kIdle].store(0);
+    m_timeouts_[(int)TimeoutType::kRead].store(0);
+    m_timeouts_[(int)TimeoutType::kConnect].store(0);
+
     if (m_port_ < 1 || m_port_ > 65535) {
         std::cerr << "SafetyTcpConn >> Endpoint >> Error >> Port: " << m_port_ << " is not Avaliable." << std::endl;
         exit(EXIT_FAILURE);
@@ -19,39 +29,71 @@ Endpoint::Endpoint(Core* core, int port, std::function<void(ConnectionPtr)> coni
     m_sockaddr_.sin_family = AF_INET;
     m_sockaddr_.sin_addr.s_addr = htons(INADDR_ANY);
 
-    // create socket
-    m_fd_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    // more listeners than reactors don't accept any faster
+    size_t listener_count = options.m_listener_count_;
+    if (listener_count > m_core_->ReactorCount())
+        listener_count = m_core_->ReactorCount();
+    if (listener_count == 0)
+        listener_count = 1;
 
-    // set address reuse
-    const int reuse_addr = 1;
-    if (setsockopt(m_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse_addr, sizeof(int)) < 0) {
-        std::cerr << "SafetyTcpConn >> Endpoint >> Error >> Socket Set SO_REUSEADDR Failure." << std::endl;
-        exit(EXIT_FAILURE);
-    }
+    for (size_t i = 0; i < listener_count; i++) {
+        // create socket, non-blocking so that accepting can stop at EAGAIN
+        const int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+        if (fd < 0) {
+            std::cerr << "SafetyTcpConn >> Endpoint >> Error >> Socket Create Failure." << std::endl;
+            exit(EXIT_FAILURE);
+        }
 
-    // bind socket
-    if (bind(m_fd_, (sockaddr *)&m_sockaddr_, sizeof(m_sockaddr_)) < 0) {
-        std::cerr << "SafetyTcpConn >> Endpoint >> Error >> Socket Bind Failure." << std::endl;
-        exit(EXIT_FAILURE);
-    }
+        // set address reuse
+        const int reuse_addr = 1;
+        if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse_addr, sizeof(int)) < 0) {
+            std::cerr << "SafetyTcpConn >> Endpoint >> Error >> Socket Set SO_REUSEADDR Failure." << std::endl;
+            exit(EXIT_FAILURE);
+        }
 
-    // listen socket
-    if (listen(m_fd_, 16) == -1) {
-        std::cerr << "SafetyTcpConn >> Endpoint >> Error >> Socket Listen Failure." << std::endl;
-        exit(EXIT_FAILURE);
+        // set port reuse, the kernel spreads new connections across the listeners
+        const int reuse_port = 1;
+        if (listener_count > 1 && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &reuse_port, sizeof(int)) < 0) {
+            std::cerr << "SafetyTcpConn >> Endpoint >> Error >> Socket Set SO_REUSEPORT Failure." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        // bind socket
+        if (bind(fd, (sockaddr *)&m_sockaddr_, sizeof(m_sockaddr_)) < 0) {
+            std::cerr << "SafetyTcpConn >> Endpoint >> Error >> Socket Bind Failure." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        // listen socket
+        if (listen(fd, options.m_backlog_) == -1) {
+            std::cerr << "SafetyTcpConn >> Endpoint >> Error >> Socket Listen Failure." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        Listener listener;
+        listener.m_fd_ = fd;
+        listener.m_reactor_ = nullptr;
+        m_listeners_.push_back(listener);
     }
+    m_fd_ = m_listeners_[0].m_fd_;
+
+    // reserved for accepting and dropping connections when out of fds
+    m_reserve_fd_ = open("/dev/null", O_RDONLY | O_CLOEXEC);
 
-    std::cout << "SafetyTcpConn >> Endpoint >> Start | FD: " << m_fd_ << std::endl;
+    std::cout << "SafetyTcpConn >> Endpoint >> Start | FD: " << m_fd_ << " | Listeners: " << m_listeners_.size() << " | Backlog: " << options.m_backlog_ << std::endl;
 }
 
 Endpoint::~Endpoint() {
     CloseEndpoint();
+    if (m_reserve_fd_ >= 0)
+        close(m_reserve_fd_);
     std::cout << "SafetyTcpConn >> Endpoint >> Safety Clean | FD: " << m_fd_ << " | Port: " << m_port_ << std::endl;
 }
 
-inline EndpointPtr Endpoint::CreateEndpoint(Core* core, int port, std::function<void(ConnectionPtr)> coninit_func, std::function<void(ConnectionPtr)> process_func, std::function<void(ConnectionPtr)> cleanup_func) {
+inline EndpointPtr Endpoint::CreateEndpoint(Core* core, int port, ConnectionFunc coninit_func, ConnectionFunc process_func, ConnectionFunc cleanup_func,
+    const TransportPolicy& policy, const ListenOptions& options) {
     EndpointPtr endpoint = std::shared_ptr<Endpoint>(
-        new Endpoint(core, port, coninit_func, process_func, cleanup_func)
+        new Endpoint(core, port, coninit_func, process_func, cleanup_func, policy, options)
     );
     
     ContainerPtr container = std::static_pointer_cast<Container>(endpoint);
@@ -60,6 +102,19 @@ inline EndpointPtr Endpoint::CreateEndpoint(Core* core, int port, std::function<
     return endpoint;
 }
 
+template <typename CodecType, typename FrameFunc>
+inline EndpointPtr Endpoint::CreateEndpoint(Core* core, int port, ConnectionFunc coninit_func, const CodecType& codec, FrameFunc frame_func, ConnectionFunc cleanup_func,
+    const TransportPolicy& policy, const ListenOptions& options) {
+    // codec and frame function are known here, so decoding is specialized for them
+    ConnectionFunc process_func = [codec, frame_func](const ConnectionPtr& conn) mutable {
+        conn->ReadFrames(codec, [&conn, &frame_func](const BufferView& frame) {
+            frame_func(conn, frame);
+        });
+    };
+
+    return CreateEndpoint(core, port, coninit_func, process_func, cleanup_func, policy, options);
+}
+
 inline bool Endpoint::IsOpen() {
     return m_open_.load();
 }
@@ -77,7 +132,9 @@ inline void Endpoint::CloseEndpoint() {
     }
 
     // unregister from core, stop accept new connection
-    m_core_->UnregisterContainer(m_fd_);
+    for (size_t i = 0; i < m_listeners_.size(); i++)
+        if (m_listeners_[i].m_reactor_ != nullptr)
+            m_listeners_[i].m_reactor_->UnregisterContainer(m_listeners_[i].m_fd_);
 
     // close all connection
     {
@@ -87,26 +144,148 @@ inline void Endpoint::CloseEndpoint() {
         m_fd_2_connptrs_.clear();
     }
 
-    // close socket fd
-    close(m_fd_);
+    // close socket fd, shutdown first so that an io_uring accept in flight ends too
+    for (size_t i = 0; i < m_listeners_.size(); i++) {
+        shutdown(m_listeners_[i].m_fd_, SHUT_RDWR);
+        close(m_listeners_[i].m_fd_);
+    }
+}
+
+inline void Endpoint::SetTimeout(const TimeoutType type, const uint32_t timeout_ms) {
+    if (type == TimeoutType::kCount) return;
+    m_timeouts_[(int)type].store(timeout_ms);
+}
+
+inline void Endpoint::SetTimeoutFunc(std::function<bool(const ConnectionPtr&, TimeoutType)> timeout_func) {
+    std::unique_lock<std::mutex> lck(m_mtx_connptrs_);
+    m_timeout_func_ = timeout_func;
+}
+
+inline void Endpoint::SetHighWatermarkFunc(ConnectionFunc high_watermark_func) {
+    std::unique_lock<std::mutex> lck(m_mtx_connptrs_);
+    m_high_watermark_func_ = std::move(high_watermark_func);
+}
+
+inline void Endpoint::SetDrainedFunc(ConnectionFunc drained_func) {
+    std::unique_lock<std::mutex> lck(m_mtx_connptrs_);
+    m_drained_func_ = std::move(drained_func);
+}
+
+inline size_t Endpoint::Broadcast(const MessagePtr& msg) {
+    if (!IsOpen() || msg == nullptr) return 0;
+
+    // take a snapshot, don't block accepting while enqueuing
+    std::vector<ConnectionPtr> conns;
+    {
+        std::unique_lock<std::mutex> lck(m_mtx_connptrs_);
+        conns.reserve(m_fd_2_connptrs_.size());
+        for (auto it = m_fd_2_connptrs_.begin(); it != m_fd_2_connptrs_.end(); it++)
+            conns.push_back(it->second);
+    }
+
+    return Broadcast(msg, conns);
+}
+
+inline size_t Endpoint::Broadcast(const std::string& msg) {
+    return Broadcast(std::make_shared<const std::string>(msg));
+}
+
+inline size_t Endpoint::Broadcast(const MessagePtr& msg, const std::vector<ConnectionPtr>& conns) {
+    if (msg == nullptr) return 0;
+
+    // group the connections need to send by reactor, then schedule each group at once
+    std::unordered_map<Reactor*, std::vector<ConnectionPtr>> reactor_2_conns;
+    size_t count = 0;
+    size_t buffered = 0;
+
+    for (size_t i = 0; i < conns.size(); i++) {
+        const ConnectionPtr& conn = conns[i];
+        if (conn == nullptr || !conn->IsConn())
+            continue;
+
+        if (conn->PushMsg(msg, buffered))
+            reactor_2_conns[conn->m_reactor_].push_back(conn);
+
+        // closed when reaching max buffer size
+        if (conn->IsConn())
+            count++;
+    }
+
+    for (auto it = reactor_2_conns.begin(); it != reactor_2_conns.end(); it++)
+        it->first->ScheduleSend(it->second);
+
+    return count;
 }
 
 //==============================
 // Endpoint Control Area
 //==============================
 
-inline ConnectionPtr Endpoint::Accept(EndpointPtr& endpoint) {
-    if (!endpoint->IsOpen()) return nullptr;
-    std::unique_lock<std::mutex> lck(endpoint->m_mtx_connptrs_);
+inline void Endpoint::Accept(EndpointPtr& endpoint, int listen_fd) {
+    for (int i = 0; i < kMaxAcceptCount && endpoint->IsOpen(); i++) {
+        // accept connection, the client fd is non-blocking from the start
+        sockaddr_in client_sockaddr{};
+        socklen_t length = sizeof(client_sockaddr);
+        int client_fd = accept4(listen_fd, (sockaddr *) &client_sockaddr, &length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if (client_fd < 0) {
+            // the client is gone before accepting, try next one
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            // out of fds, drop the connection rather than leaving the listener readable
+            if ((errno == EMFILE || errno == ENFILE) && endpoint->DropPending(listen_fd))
+                continue;
+            // no more connection (EAGAIN), try again on next wake up
+            return;
+        }
+
+        // hand it to the least loaded reactor
+        ContainerPtr conn = Adopt(endpoint, client_fd);
+        if (conn == nullptr)
+            close(client_fd);
+        else
+            endpoint->m_core_->RegisterContainer(conn);
+    }
+}
+
+inline int Endpoint::ListenFd(const Reactor* reactor) {
+    for (size_t i = 0; i < m_listeners_.size(); i++)
+        if (m_listeners_[i].m_reactor_ == reactor)
+            return m_listeners_[i].m_fd_;
+    return -1;
+}
+
+inline bool Endpoint::DropPending(int listen_fd) {
+    std::unique_lock<std::mutex> lck(m_reserve_mtx_);
+    if (m_reserve_fd_ < 0)
+        m_reserve_fd_ = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (m_reserve_fd_ < 0)
+        return false;
+
+    // give the reserved fd back, the client sees the connection closed instead of waiting in the queue
+    close(m_reserve_fd_);
+    const int client_fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client_fd >= 0)
+        close(client_fd);
+
+    // another thread may take the fd first, then it is reserved again on the next drop
+    m_reserve_fd_ = open("/dev/null", O_RDONLY | O_CLOEXEC);
 
-    // accept connection
-    sockaddr_in client_sockaddr{};
-    socklen_t length = sizeof(client_sockaddr);
-    int client_fd = accept(endpoint->m_fd_, (sockaddr *) &client_sockaddr, &length);
+    if (client_fd < 0)
+        return false;
+    Metrics::Add(MetricCounter::kAcceptDrops);
+    return true;
+}
+
+inline ConnectionPtr Endpoint::Adopt(EndpointPtr& endpoint, int client_fd) {
+    if (!endpoint->IsOpen() || client_fd < 0) return nullptr;
+    std::unique_lock<std::mutex> lck(endpoint->m_mtx_connptrs_);
 
-    // create connection instance
-    ConnectionPtr conn = std::shared_ptr<Connection>(new Connection(client_fd, endpoint));
+    // create connection instance, it shares one pooled block with its control block,
+    // the block goes back to the pool when the last weak reference is gone
+    ConnectionPtr conn = std::allocate_shared<Connection>(PoolAllocator<Connection>(), client_fd, endpoint);
     endpoint->m_fd_2_connptrs_[conn->m_fd_] = conn;
+    Metrics::Add(MetricCounter::kAccepts);
 
     return conn;
 }
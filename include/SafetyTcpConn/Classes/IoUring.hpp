@@ -0,0 +1,107 @@
+#ifndef STC_IO_URING_HPP
+#define STC_IO_URING_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__linux__) && defined(__has_include)
+    #if __has_include(<linux/io_uring.h>) && !defined(STC_NO_IO_URING)
+        #include <linux/io_uring.h>
+        // multishot recv and cancel-any came with 6.0 headers, the provided buffer ring before them is an enum and can't be checked
+        #if defined(IORING_RECV_MULTISHOT) && defined(IORING_ASYNC_CANCEL_ANY)
+            #define STC_HAS_IO_URING 1
+        #endif
+    #endif
+#endif
+
+#include "Classes.hpp"
+
+namespace SafetyTcpConn {
+
+#ifdef STC_HAS_IO_URING
+
+/// @brief Minimal io_uring wrapper on raw syscalls: one submission queue, one completion queue and one provided buffer ring.
+/// @note It is not thread-safe, only the reactor thread which owns it can use it.
+class IoUring {
+private:
+    int             m_ring_fd_;
+
+    // submission queue
+    void*           m_sq_ptr_;
+    size_t          m_sq_size_;
+    unsigned*       m_sq_head_;
+    unsigned*       m_sq_tail_;
+    unsigned*       m_sq_mask_;
+    unsigned*       m_sq_array_;
+    unsigned        m_sq_entries_;
+    unsigned        m_sq_local_tail_;
+    unsigned        m_sq_pending_;
+    io_uring_sqe*   m_sqes_;
+    size_t          m_sqes_size_;
+
+    // completion queue
+    void*           m_cq_ptr_;
+    size_t          m_cq_size_;
+    unsigned*       m_cq_head_;
+    unsigned*       m_cq_tail_;
+    unsigned*       m_cq_mask_;
+    io_uring_cqe*   m_cqes_;
+
+    // provided buffer ring, used by multishot recv
+    // entries are indexed as a plain array, `io_uring_buf_ring::bufs` has a different offset when compiled as C++
+    io_uring_buf*       m_buf_ring_;
+    unsigned short*     m_buf_tail_;
+    size_t              m_buf_ring_size_;
+    char*               m_bufs_;
+    unsigned            m_buf_count_;
+    unsigned            m_buf_size_;
+    unsigned short      m_buf_group_;
+    bool                m_buf_registered_;
+public:
+    IoUring();
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    /// @brief Create the ring and register a provided buffer ring of `buf_count` buffers of `buf_size` bytes
+    /// @return `bool`: ready(`true`) / not supported by the kernel(`false`)
+    bool Init(unsigned entries, unsigned buf_count, unsigned buf_size, unsigned short buf_group);
+
+    bool IsReady() const;
+
+    unsigned short BufferGroup() const;
+
+    /// @brief Get a cleared submission entry, pending entries are submitted first when the queue is full
+    io_uring_sqe* GetSqe();
+
+    /// @brief Submit pending entries and wait for at least `wait_nr` completions or `timeout_ms`
+    /// @return `int`: result of io_uring_enter
+    int Submit(unsigned wait_nr, int timeout_ms);
+
+    /// @brief Hand every completion to `cqe_func` and mark them as seen
+    /// @param cqe_func function like `void(const io_uring_cqe& cqe)`
+    /// @return `unsigned`: count of completions
+    template <typename CqeFunc>
+    unsigned ForEachCqe(CqeFunc&& cqe_func);
+
+    /// @brief Get the provided buffer selected by a completion
+    const char* GetBuffer(unsigned short buf_id) const;
+
+    /// @brief Give a provided buffer back to the kernel
+    void RecycleBuffer(unsigned short buf_id);
+
+    /// @brief Cancel every operation in flight and drop completions until the kernel has none left
+    /// @note Call it from the thread which submitted the operations, their completions are run by that thread
+    void CancelAll();
+
+    /// @brief Close the ring, operations in flight are cancelled and completed before the buffers are released
+    /// @note Everything the operations use (messages, send blocks) can be released once it returns
+    void Close();
+};
+
+#endif
+
+}
+
+#endif
\ No newline at end of file
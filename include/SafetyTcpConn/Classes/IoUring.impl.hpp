@@ -0,0 +1,287 @@
+#ifndef STC_IO_URING_FUNC_HPP
+#define STC_IO_URING_FUNC_HPP
+
+#include "IoUring.hpp"
+
+#ifdef STC_HAS_IO_URING
+
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+#include <ctime>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace SafetyTcpConn {
+
+IoUring::IoUring() :
+    m_ring_fd_(-1),
+    m_sq_ptr_(MAP_FAILED), m_sq_size_(0), m_sq_head_(nullptr), m_sq_tail_(nullptr), m_sq_mask_(nullptr), m_sq_array_(nullptr),
+    m_sq_entries_(0), m_sq_local_tail_(0), m_sq_pending_(0), m_sqes_(nullptr), m_sqes_size_(0),
+    m_cq_ptr_(MAP_FAILED), m_cq_size_(0), m_cq_head_(nullptr), m_cq_tail_(nullptr), m_cq_mask_(nullptr), m_cqes_(nullptr),
+    m_buf_ring_(nullptr), m_buf_tail_(nullptr), m_buf_ring_size_(0), m_bufs_(nullptr), m_buf_count_(0), m_buf_size_(0), m_buf_group_(0),
+    m_buf_registered_(false)
+{
+}
+
+IoUring::~IoUring() {
+    Close();
+}
+
+inline bool IoUring::Init(unsigned entries, unsigned buf_count, unsigned buf_size, unsigned short buf_group) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CLAMP;
+
+    if ((m_ring_fd_ = (int)syscall(__NR_io_uring_setup, entries, &params)) < 0)
+        return false;
+
+    // timeout when waiting is passed by io_uring_getevents_arg
+    if (!(params.features & IORING_FEAT_EXT_ARG)) {
+        Close();
+        return false;
+    }
+
+    // map submission queue and completion queue
+    m_sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap && m_cq_size_ > m_sq_size_)
+        m_sq_size_ = m_cq_size_;
+
+    m_sq_ptr_ = mmap(nullptr, m_sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd_, IORING_OFF_SQ_RING);
+    if (m_sq_ptr_ == MAP_FAILED) {
+        Close();
+        return false;
+    }
+
+    if (single_mmap) {
+        m_cq_ptr_ = m_sq_ptr_;
+    }
+    else {
+        m_cq_ptr_ = mmap(nullptr, m_cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd_, IORING_OFF_CQ_RING);
+        if (m_cq_ptr_ == MAP_FAILED) {
+            Close();
+            return false;
+        }
+    }
+
+    char* sq_ptr = static_cast<char*>(m_sq_ptr_);
+    m_sq_head_ = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.head);
+    m_sq_tail_ = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.tail);
+    m_sq_mask_ = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.ring_mask);
+    m_sq_array_ = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.array);
+    m_sq_entries_ = params.sq_entries;
+    m_sq_local_tail_ = *m_sq_tail_;
+
+    m_sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, m_sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        Close();
+        return false;
+    }
+    m_sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    char* cq_ptr = static_cast<char*>(m_cq_ptr_);
+    m_cq_head_ = reinterpret_cast<unsigned*>(cq_ptr + params.cq_off.head);
+    m_cq_tail_ = reinterpret_cast<unsigned*>(cq_ptr + params.cq_off.tail);
+    m_cq_mask_ = reinterpret_cast<unsigned*>(cq_ptr + params.cq_off.ring_mask);
+    m_cqes_ = reinterpret_cast<io_uring_cqe*>(cq_ptr + params.cq_off.cqes);
+
+    // provided buffer ring, count must be a power of 2
+    m_buf_count_ = buf_count;
+    m_buf_size_ = buf_size;
+    m_buf_group_ = buf_group;
+    m_buf_ring_size_ = buf_count * sizeof(io_uring_buf);
+
+    void* buf_ring = mmap(nullptr, m_buf_ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf_ring == MAP_FAILED) {
+        Close();
+        return false;
+    }
+    m_buf_ring_ = static_cast<io_uring_buf*>(buf_ring);
+    // the ring tail overlays the `resv` field of the first entry
+    m_buf_tail_ = &m_buf_ring_[0].resv;
+    m_bufs_ = new char[(size_t)buf_count * buf_size];
+
+    io_uring_buf_reg reg;
+    std::memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(m_buf_ring_);
+    reg.ring_entries = buf_count;
+    reg.bgid = buf_group;
+    if (syscall(__NR_io_uring_register, m_ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        Close();
+        return false;
+    }
+    m_buf_registered_ = true;
+
+    for (unsigned i = 0; i < buf_count; i++) {
+        io_uring_buf& buf = m_buf_ring_[i];
+        buf.addr = reinterpret_cast<uint64_t>(m_bufs_ + (size_t)i * buf_size);
+        buf.len = buf_size;
+        buf.bid = (unsigned short)i;
+    }
+    __atomic_store_n(m_buf_tail_, (unsigned short)buf_count, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+inline bool IoUring::IsReady() const {
+    return m_ring_fd_ >= 0;
+}
+
+inline unsigned short IoUring::BufferGroup() const {
+    return m_buf_group_;
+}
+
+inline io_uring_sqe* IoUring::GetSqe() {
+    // submission queue is full, let the kernel take them first
+    if (m_sq_local_tail_ - __atomic_load_n(m_sq_head_, __ATOMIC_ACQUIRE) >= m_sq_entries_)
+        Submit(0, 0);
+
+    const unsigned index = m_sq_local_tail_ & *m_sq_mask_;
+    io_uring_sqe* sqe = &m_sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+
+    m_sq_array_[index] = index;
+    m_sq_local_tail_++;
+    m_sq_pending_++;
+    return sqe;
+}
+
+inline int IoUring::Submit(unsigned wait_nr, int timeout_ms) {
+    // publish the prepared entries
+    __atomic_store_n(m_sq_tail_, m_sq_local_tail_, __ATOMIC_RELEASE);
+
+    unsigned flags = 0;
+    io_uring_getevents_arg arg;
+    __kernel_timespec ts;
+    std::memset(&arg, 0, sizeof(arg));
+
+    if (wait_nr > 0) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+        arg.sigmask_sz = _NSIG / 8;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+        flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+    }
+
+    const unsigned to_submit = m_sq_pending_;
+    const int ret = (int)syscall(__NR_io_uring_enter, m_ring_fd_, to_submit, wait_nr, flags, wait_nr > 0 ? &arg : nullptr, sizeof(arg));
+    if (ret >= 0)
+        m_sq_pending_ -= (unsigned)ret < to_submit ? (unsigned)ret : to_submit;
+
+    return ret;
+}
+
+template <typename CqeFunc>
+inline unsigned IoUring::ForEachCqe(CqeFunc&& cqe_func) {
+    unsigned head = *m_cq_head_;
+    const unsigned tail = __atomic_load_n(m_cq_tail_, __ATOMIC_ACQUIRE);
+    unsigned count = 0;
+
+    while (head != tail) {
+        const io_uring_cqe cqe = m_cqes_[head & *m_cq_mask_];
+        head++;
+        count++;
+
+        // release the entry before handling it, handling may submit and wait again
+        __atomic_store_n(m_cq_head_, head, __ATOMIC_RELEASE);
+        cqe_func(cqe);
+    }
+
+    return count;
+}
+
+inline const char* IoUring::GetBuffer(unsigned short buf_id) const {
+    return m_bufs_ + (size_t)buf_id * m_buf_size_;
+}
+
+inline void IoUring::RecycleBuffer(unsigned short buf_id) {
+    const unsigned short tail = *m_buf_tail_;
+    io_uring_buf& buf = m_buf_ring_[tail & (m_buf_count_ - 1)];
+    buf.addr = reinterpret_cast<uint64_t>(m_bufs_ + (size_t)buf_id * m_buf_size_);
+    buf.len = m_buf_size_;
+    buf.bid = buf_id;
+    __atomic_store_n(m_buf_tail_, (unsigned short)(tail + 1), __ATOMIC_RELEASE);
+}
+
+inline void IoUring::CancelAll() {
+    static const uint64_t kCancelData = ~0ULL;
+    static const int kMaxRounds = 100;
+    static const int kWaitMs = 10;
+
+    // closing the ring fd does not wait for operations in flight, a multishot recv may still write into the buffers
+    // repeat until nothing matches, an operation being run by an io-wq worker only completes after it sees the cancel
+    for (int round = 0; round < kMaxRounds; round++) {
+        io_uring_sqe* sqe = GetSqe();
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL | IORING_ASYNC_CANCEL_ANY;
+        sqe->user_data = kCancelData;
+
+        bool answered = false;
+        int result = 0;
+        for (int wait = 0; wait < kMaxRounds && !answered; wait++) {
+            if (Submit(1, kWaitMs) < 0 && errno != ETIME && errno != EINTR && errno != EBUSY)
+                return;
+            // completions of the cancelled operations are dropped, nobody handles them anymore
+            ForEachCqe([&](const io_uring_cqe& cqe) {
+                if (cqe.user_data == kCancelData) {
+                    answered = true;
+                    result = cqe.res;
+                }
+            });
+        }
+
+        // nothing left, or the kernel does not support cancelling any operation
+        if (!answered || result == -ENOENT || result == 0 || result == -EINVAL)
+            return;
+    }
+}
+
+inline void IoUring::Close() {
+    if (m_ring_fd_ >= 0 && m_sqes_ != nullptr && m_cqes_ != nullptr)
+        CancelAll();
+
+    // without a buffer ring, a recv not cancelled above can not select a buffer anymore
+    if (m_buf_registered_) {
+        io_uring_buf_reg reg;
+        std::memset(&reg, 0, sizeof(reg));
+        reg.bgid = m_buf_group_;
+        syscall(__NR_io_uring_register, m_ring_fd_, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    }
+    m_buf_registered_ = false;
+
+    if (m_ring_fd_ >= 0)
+        close(m_ring_fd_);
+    m_ring_fd_ = -1;
+
+    if (m_sqes_ != nullptr)
+        munmap(m_sqes_, m_sqes_size_);
+    m_sqes_ = nullptr;
+
+    if (m_cq_ptr_ != MAP_FAILED && m_cq_ptr_ != m_sq_ptr_)
+        munmap(m_cq_ptr_, m_cq_size_);
+    m_cq_ptr_ = MAP_FAILED;
+
+    if (m_sq_ptr_ != MAP_FAILED)
+        munmap(m_sq_ptr_, m_sq_size_);
+    m_sq_ptr_ = MAP_FAILED;
+
+    if (m_buf_ring_ != nullptr)
+        munmap(m_buf_ring_, m_buf_ring_size_);
+    m_buf_ring_ = nullptr;
+    m_buf_tail_ = nullptr;
+
+    delete [] m_bufs_;
+    m_bufs_ = nullptr;
+}
+
+}
+
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,140 @@
+#ifndef STC_METRICS_HPP
+#define STC_METRICS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Classes.hpp"
+
+namespace SafetyTcpConn {
+
+enum class MetricCounter {
+    kAccepts,               // connections accepted
+    kAcceptDrops,           // connections accepted and closed at once for out of fds
+    kCloses,                // connections closed, for any reason
+    kBytesIn,               // bytes received
+    kBytesOut,              // bytes sent
+    kSendStallCloses,       // connections closed by the send stall timeout
+    kIdleCloses,            // connections closed by the idle timeout
+    kReadCloses,            // connections closed by the read timeout
+    kBufferGrowths,         // recv / send buffers grown to a larger block
+    kBufferLimitCloses,     // connections closed for reaching the max buffer size
+    kConnects,              // outbound connections established
+    kConnectFailures,       // outbound connections failed or timed out before established
+    kZeroCopySends,         // sends with `MSG_ZEROCOPY`
+    kZeroCopyCopied,        // zero-copy sends completed by copying in the kernel
+    kCount
+};
+
+enum class MetricHistogram {
+    kCallbackUs,        // duration of process functions, in microseconds
+    kEnqueueToWireUs,   // from a message enqueued into an empty send queue to the send that writes it, in microseconds
+    kLoopUs,            // work time of one reactor loop iteration without waiting for events, in microseconds
+    kEventBatch,        // events or completions handled by one reactor loop iteration
+    kCount
+};
+
+/// @brief Values of one histogram, bucket `0` holds `0`, bucket `i` holds values from `2^(i-1)` to `2^i - 1`.
+class HistogramSnapshot {
+public:
+    static constexpr int kBucketCount = 32;
+
+    uint64_t    m_buckets_[kBucketCount];
+    uint64_t    m_count_;
+    uint64_t    m_sum_;
+
+    HistogramSnapshot();
+
+    /// @brief Get the upper bound of bucket `index`, the last bucket has no bound and holds everything larger
+    static uint64_t BucketBound(const int index);
+
+    /// @brief Get the bucket of `value`
+    static int BucketIndex(const uint64_t value);
+
+    /// @brief Get an upper estimate of the `quantile` of recorded values
+    /// @param quantile from `0` to `1`. example: `0.5`, `0.99`, `0.999`
+    /// @return `uint64_t`: upper bound of the bucket holding the quantile / `0` when nothing is recorded
+    uint64_t Percentile(const double quantile) const;
+
+    /// @brief Get the mean of recorded values
+    double Mean() const;
+};
+
+/// @brief Values of all counters and histograms at one moment.
+class MetricsSnapshot {
+public:
+    uint64_t            m_counters_[(int)MetricCounter::kCount];
+    HistogramSnapshot   m_histograms_[(int)MetricHistogram::kCount];
+
+    MetricsSnapshot();
+
+    uint64_t Get(const MetricCounter counter) const;
+    const HistogramSnapshot& Get(const MetricHistogram histogram) const;
+
+    /// @brief Export all values in Prometheus text format, names start with `stc_`
+    std::string ToText() const;
+};
+
+/// @brief Process-wide counters and histograms, each thread writes its own shard without locking.
+/// @note Reading takes a lock and sums all shards, so only `Snapshot` and `Export` are slow.
+/// Define `STC_NO_METRICS` (or `-DSTC_METRICS=OFF` with CMake) to compile all recording out.
+class Metrics {
+private:
+    // values written by one thread, other threads only read them
+    class Shard {
+    public:
+        std::atomic<uint64_t>   m_counters_[(int)MetricCounter::kCount];
+        std::atomic<uint64_t>   m_buckets_[(int)MetricHistogram::kCount][HistogramSnapshot::kBucketCount];
+        std::atomic<uint64_t>   m_sums_[(int)MetricHistogram::kCount];
+
+        Shard();
+        ~Shard();
+
+        /// @brief Add the values of this shard to `snapshot`
+        void AddTo(MetricsSnapshot& snapshot) const;
+    };
+
+    // shards of alive threads, and values left by ended threads
+    class Registry {
+    public:
+        std::mutex          m_mtx_;
+        std::vector<Shard*> m_shards_;
+        MetricsSnapshot     m_retired_;
+    };
+
+public:
+    Metrics() = delete;
+
+    /// @brief Add `value` to a counter
+    static void Add(const MetricCounter counter, const uint64_t value = 1);
+
+    /// @brief Record one value into a histogram
+    static void Record(const MetricHistogram histogram, const uint64_t value);
+
+    /// @brief Get current microseconds of steady clock / `0` when metrics are compiled out
+    static uint64_t NowUs();
+
+    /// @brief Sum the shards of all threads
+    static MetricsSnapshot Snapshot();
+
+    /// @brief Same as `Snapshot().ToText()`
+    static std::string Export();
+
+    /// @brief Get the name of a counter / histogram used by the text exporter
+    static const char* Name(const MetricCounter counter);
+    static const char* Name(const MetricHistogram histogram);
+
+private:
+    /// @brief Get the registry, it is never destroyed, threads can still end while static objects are destroyed
+    static Registry& Instance();
+
+    static Shard& LocalShard();
+};
+
+}
+
+#endif
\ No newline at end of file
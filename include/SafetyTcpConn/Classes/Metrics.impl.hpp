@@ -0,0 +1,221 @@
+#ifndef STC_METRICS_FUNC_HPP
+#define STC_METRICS_FUNC_HPP
+
+#include <chrono>
+#include <sstream>
+
+#include "Metrics.hpp"
+
+namespace SafetyTcpConn {
+
+HistogramSnapshot::HistogramSnapshot() : m_count_(0), m_sum_(0) {
+    for (int i = 0; i < kBucketCount; i++)
+        m_buckets_[i] = 0;
+}
+
+inline uint64_t HistogramSnapshot::BucketBound(const int index) {
+    return index <= 0 ? 0 : ((uint64_t)1 << index) - 1;
+}
+
+inline int HistogramSnapshot::BucketIndex(const uint64_t value) {
+    int index = 0;
+    uint64_t rest = value;
+    while (rest > 0 && index < kBucketCount - 1) {
+        rest >>= 1;
+        index++;
+    }
+    return index;
+}
+
+inline uint64_t HistogramSnapshot::Percentile(const double quantile) const {
+    if (m_count_ == 0)
+        return 0;
+
+    // rank of the quantile, counted from 1
+    uint64_t rank = (uint64_t)(quantile * m_count_ + 0.5);
+    if (rank < 1)
+        rank = 1;
+    if (rank > m_count_)
+        rank = m_count_;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < kBucketCount; i++) {
+        seen += m_buckets_[i];
+        if (seen >= rank)
+            return BucketBound(i);
+    }
+    return BucketBound(kBucketCount - 1);
+}
+
+inline double HistogramSnapshot::Mean() const {
+    return m_count_ == 0 ? 0 : (double)m_sum_ / m_count_;
+}
+
+MetricsSnapshot::MetricsSnapshot() {
+    for (int i = 0; i < (int)MetricCounter::kCount; i++)
+        m_counters_[i] = 0;
+}
+
+inline uint64_t MetricsSnapshot::Get(const MetricCounter counter) const {
+    return m_counters_[(int)counter];
+}
+
+inline const HistogramSnapshot& MetricsSnapshot::Get(const MetricHistogram histogram) const {
+    return m_histograms_[(int)histogram];
+}
+
+inline std::string MetricsSnapshot::ToText() const {
+    std::ostringstream out;
+
+    for (int i = 0; i < (int)MetricCounter::kCount; i++) {
+        const char* name = Metrics::Name((MetricCounter)i);
+        out << "# TYPE stc_" << name << " counter\n";
+        out << "stc_" << name << " " << m_counters_[i] << "\n";
+    }
+
+    for (int i = 0; i < (int)MetricHistogram::kCount; i++) {
+        const char* name = Metrics::Name((MetricHistogram)i);
+        const HistogramSnapshot& histogram = m_histograms_[i];
+        out << "# TYPE stc_" << name << " histogram\n";
+
+        // buckets are cumulative, the last one is +Inf
+        uint64_t seen = 0;
+        for (int j = 0; j < HistogramSnapshot::kBucketCount - 1; j++) {
+            seen += histogram.m_buckets_[j];
+            out << "stc_" << name << "_bucket{le=\"" << HistogramSnapshot::BucketBound(j) << "\"} " << seen << "\n";
+        }
+        out << "stc_" << name << "_bucket{le=\"+Inf\"} " << histogram.m_count_ << "\n";
+        out << "stc_" << name << "_sum " << histogram.m_sum_ << "\n";
+        out << "stc_" << name << "_count " << histogram.m_count_ << "\n";
+    }
+
+    return out.str();
+}
+
+Metrics::Shard::Shard() {
+    for (int i = 0; i < (int)MetricCounter::kCount; i++)
+        m_counters_[i].store(0, std::memory_order_relaxed);
+    for (int i = 0; i < (int)MetricHistogram::kCount; i++) {
+        for (int j = 0; j < HistogramSnapshot::kBucketCount; j++)
+            m_buckets_[i][j].store(0, std::memory_order_relaxed);
+        m_sums_[i].store(0, std::memory_order_relaxed);
+    }
+
+    Registry& registry = Instance();
+    std::unique_lock<std::mutex> lck(registry.m_mtx_);
+    registry.m_shards_.push_back(this);
+}
+
+Metrics::Shard::~Shard() {
+    // keep the values of the ended thread
+    Registry& registry = Instance();
+    std::unique_lock<std::mutex> lck(registry.m_mtx_);
+    AddTo(registry.m_retired_);
+
+    for (size_t i = 0; i < registry.m_shards_.size(); i++) {
+        if (registry.m_shards_[i] == this) {
+            registry.m_shards_[i] = registry.m_shards_.back();
+            registry.m_shards_.pop_back();
+            break;
+        }
+    }
+}
+
+inline void Metrics::Shard::AddTo(MetricsSnapshot& snapshot) const {
+    for (int i = 0; i < (int)MetricCounter::kCount; i++)
+        snapshot.m_counters_[i] += m_counters_[i].load(std::memory_order_relaxed);
+
+    for (int i = 0; i < (int)MetricHistogram::kCount; i++) {
+        HistogramSnapshot& histogram = snapshot.m_histograms_[i];
+        for (int j = 0; j < HistogramSnapshot::kBucketCount; j++) {
+            const uint64_t count = m_buckets_[i][j].load(std::memory_order_relaxed);
+            histogram.m_buckets_[j] += count;
+            histogram.m_count_ += count;
+        }
+        histogram.m_sum_ += m_sums_[i].load(std::memory_order_relaxed);
+    }
+}
+
+inline void Metrics::Add(const MetricCounter counter, const uint64_t value) {
+#ifndef STC_NO_METRICS
+    // only this thread writes the shard, a plain load and store is enough
+    std::atomic<uint64_t>& target = LocalShard().m_counters_[(int)counter];
+    target.store(target.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+#endif
+}
+
+inline void Metrics::Record(const MetricHistogram histogram, const uint64_t value) {
+#ifndef STC_NO_METRICS
+    Shard& shard = LocalShard();
+    std::atomic<uint64_t>& bucket = shard.m_buckets_[(int)histogram][HistogramSnapshot::BucketIndex(value)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic<uint64_t>& sum = shard.m_sums_[(int)histogram];
+    sum.store(sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+#endif
+}
+
+inline uint64_t Metrics::NowUs() {
+#ifndef STC_NO_METRICS
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+    return 0;
+#endif
+}
+
+inline MetricsSnapshot Metrics::Snapshot() {
+    Registry& registry = Instance();
+    std::unique_lock<std::mutex> lck(registry.m_mtx_);
+
+    MetricsSnapshot snapshot = registry.m_retired_;
+    for (size_t i = 0; i < registry.m_shards_.size(); i++)
+        registry.m_shards_[i]->AddTo(snapshot);
+    return snapshot;
+}
+
+inline std::string Metrics::Export() {
+    return Snapshot().ToText();
+}
+
+inline const char* Metrics::Name(const MetricCounter counter) {
+    switch (counter) {
+        case MetricCounter::kAccepts:           return "accepts_total";
+        case MetricCounter::kAcceptDrops:       return "accept_drops_total";
+        case MetricCounter::kCloses:            return "closes_total";
+        case MetricCounter::kBytesIn:           return "bytes_in_total";
+        case MetricCounter::kBytesOut:          return "bytes_out_total";
+        case MetricCounter::kSendStallCloses:   return "send_stall_closes_total";
+        case MetricCounter::kIdleCloses:        return "idle_closes_total";
+        case MetricCounter::kReadCloses:        return "read_closes_total";
+        case MetricCounter::kBufferGrowths:     return "buffer_growths_total";
+        case MetricCounter::kBufferLimitCloses: return "buffer_limit_closes_total";
+        case MetricCounter::kConnects:          return "connects_total";
+        case MetricCounter::kConnectFailures:   return "connect_failures_total";
+        case MetricCounter::kZeroCopySends:     return "zerocopy_sends_total";
+        case MetricCounter::kZeroCopyCopied:    return "zerocopy_copied_total";
+        default:                                return "unknown";
+    }
+}
+
+inline const char* Metrics::Name(const MetricHistogram histogram) {
+    switch (histogram) {
+        case MetricHistogram::kCallbackUs:      return "callback_duration_us";
+        case MetricHistogram::kEnqueueToWireUs: return "enqueue_to_wire_us";
+        case MetricHistogram::kLoopUs:          return "loop_iteration_us";
+        case MetricHistogram::kEventBatch:      return "event_batch_size";
+        default:                                return "unknown";
+    }
+}
+
+inline Metrics::Registry& Metrics::Instance() {
+    static Registry* registry = new Registry();
+    return *registry;
+}
+
+inline Metrics::Shard& Metrics::LocalShard() {
+    static thread_local Shard shard;
+    return shard;
+}
+
+}
+
+#endif
\ No newline at end of file
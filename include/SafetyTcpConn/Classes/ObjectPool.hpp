@@ -0,0 +1,99 @@
+#ifndef STC_OBJECT_POOL_HPP
+#define STC_OBJECT_POOL_HPP
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <utility>
+
+#include "Classes.hpp"
+
+namespace SafetyTcpConn {
+
+/// @brief Free list of memory blocks for objects of type `T`.
+/// @note Each thread keeps up to `kThreadCacheCount` free blocks without locking, the rest go to a shared free list
+/// which keeps up to `kMaxPooledCount` blocks and gives the others back to the system.
+template <typename T>
+class ObjectPool {
+public:
+    static constexpr size_t kThreadCacheCount   = 64;
+    static constexpr size_t kMaxPooledCount     = 4096;
+private:
+    // free blocks are linked through their own memory
+    union FreeBlock {
+        FreeBlock*  m_next_;
+        alignas(T) char m_data_[sizeof(T)];
+    };
+
+    // free blocks kept by one thread, returned to the shared list when the thread ends
+    class ThreadCache {
+    public:
+        FreeBlock*  m_free_;
+        size_t      m_free_count_;
+
+        ThreadCache() : m_free_(nullptr), m_free_count_(0) {};
+        ~ThreadCache();
+    };
+
+    std::mutex  m_mtx_;
+    FreeBlock*  m_free_;
+    size_t      m_free_count_;
+private:
+    ObjectPool() : m_free_(nullptr), m_free_count_(0) {};
+
+public:
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    /// @brief Get memory for one `T`, the object is not constructed
+    static void* Allocate();
+
+    /// @brief Give the memory of one destroyed `T` back to the pool
+    static void Release(void* ptr);
+
+private:
+    /// @brief Get the shared list, it is never destroyed, blocks can still be released while static objects are destroyed
+    static ObjectPool& Instance();
+
+    static ThreadCache& LocalCache();
+
+    /// @brief Get whether the cache of this thread is destroyed, blocks are then allocated and released through the shared list
+    static bool& CacheDestroyed();
+
+    /// @brief Move a chain of free blocks into the shared list, the blocks over `kMaxPooledCount` are deleted
+    void Put(FreeBlock* head);
+
+    /// @brief Take up to `count` free blocks from the shared list
+    FreeBlock* Take(size_t& count);
+};
+
+/// @brief Allocator which takes memory from `ObjectPool`.
+/// @note Use it with `std::allocate_shared`, the object and its control block are allocated together as one pooled block.
+/// It constructs objects by itself, so classes with private constructors can make it a friend.
+template <typename T>
+class PoolAllocator {
+public:
+    typedef T value_type;
+
+    PoolAllocator() {};
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) {};
+
+    T* allocate(size_t count);
+    void deallocate(T* ptr, size_t count);
+
+    template <typename U, typename... Args>
+    void construct(U* ptr, Args&&... args);
+
+    template <typename U>
+    void destroy(U* ptr);
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>&) const { return true; };
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>&) const { return false; };
+};
+
+}
+
+#endif
\ No newline at end of file
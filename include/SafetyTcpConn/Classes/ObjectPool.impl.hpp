@@ -0,0 +1,164 @@
+#ifndef STC_OBJECT_POOL_FUNC_HPP
+#define STC_OBJECT_POOL_FUNC_HPP
+
+#include "ObjectPool.hpp"
+
+namespace SafetyTcpConn {
+
+template <typename T>
+ObjectPool<T>::ThreadCache::~ThreadCache() {
+    // static objects destroyed after it may still allocate and release on this thread
+    CacheDestroyed() = true;
+    if (m_free_ != nullptr)
+        ObjectPool<T>::Instance().Put(m_free_);
+    m_free_ = nullptr;
+    m_free_count_ = 0;
+}
+
+template <typename T>
+inline void* ObjectPool<T>::Allocate() {
+    if (CacheDestroyed()) {
+        size_t count = 1;
+        FreeBlock* block = Instance().Take(count);
+        return block != nullptr ? block : ::operator new(sizeof(FreeBlock));
+    }
+
+    // lock-free hit in the cache of this thread
+    ThreadCache& cache = LocalCache();
+    if (cache.m_free_ == nullptr) {
+        // refill half of the cache from the shared list
+        size_t count = kThreadCacheCount / 2;
+        cache.m_free_ = Instance().Take(count);
+        cache.m_free_count_ = count;
+    }
+
+    FreeBlock* block = cache.m_free_;
+    if (block == nullptr)
+        return ::operator new(sizeof(FreeBlock));
+
+    cache.m_free_ = block->m_next_;
+    cache.m_free_count_--;
+    return block;
+}
+
+template <typename T>
+inline void ObjectPool<T>::Release(void* ptr) {
+    if (ptr == nullptr)
+        return;
+
+    FreeBlock* block = static_cast<FreeBlock*>(ptr);
+    if (CacheDestroyed()) {
+        block->m_next_ = nullptr;
+        Instance().Put(block);
+        return;
+    }
+
+    ThreadCache& cache = LocalCache();
+    block->m_next_ = cache.m_free_;
+    cache.m_free_ = block;
+    cache.m_free_count_++;
+
+    // cache is full, move half of it to the shared list
+    if (cache.m_free_count_ > kThreadCacheCount) {
+        FreeBlock* head = cache.m_free_;
+        FreeBlock* tail = head;
+        const size_t count = kThreadCacheCount / 2;
+        for (size_t i = 1; i < count; i++)
+            tail = tail->m_next_;
+
+        cache.m_free_ = tail->m_next_;
+        cache.m_free_count_ -= count;
+        tail->m_next_ = nullptr;
+        Instance().Put(head);
+    }
+}
+
+template <typename T>
+inline ObjectPool<T>& ObjectPool<T>::Instance() {
+    static ObjectPool<T>* pool = new ObjectPool<T>();
+    return *pool;
+}
+
+template <typename T>
+inline typename ObjectPool<T>::ThreadCache& ObjectPool<T>::LocalCache() {
+    static thread_local ThreadCache cache;
+    return cache;
+}
+
+template <typename T>
+inline bool& ObjectPool<T>::CacheDestroyed() {
+    // trivially destructible, still readable after the cache is destroyed
+    static thread_local bool destroyed = false;
+    return destroyed;
+}
+
+template <typename T>
+inline void ObjectPool<T>::Put(FreeBlock* head) {
+    std::unique_lock<std::mutex> lck(m_mtx_);
+    while (head != nullptr) {
+        FreeBlock* next = head->m_next_;
+
+        // enough blocks are kept already, give the rest back to the system
+        if (m_free_count_ >= kMaxPooledCount) {
+            ::operator delete(head);
+        }
+        else {
+            head->m_next_ = m_free_;
+            m_free_ = head;
+            m_free_count_++;
+        }
+
+        head = next;
+    }
+}
+
+template <typename T>
+inline typename ObjectPool<T>::FreeBlock* ObjectPool<T>::Take(size_t& count) {
+    std::unique_lock<std::mutex> lck(m_mtx_);
+
+    FreeBlock* head = nullptr;
+    size_t taken = 0;
+    while (taken < count && m_free_ != nullptr) {
+        FreeBlock* block = m_free_;
+        m_free_ = block->m_next_;
+        m_free_count_--;
+
+        block->m_next_ = head;
+        head = block;
+        taken++;
+    }
+
+    count = taken;
+    return head;
+}
+
+template <typename T>
+inline T* PoolAllocator<T>::allocate(size_t count) {
+    if (count == 1)
+        return static_cast<T*>(ObjectPool<T>::Allocate());
+    return static_cast<T*>(::operator new(count * sizeof(T)));
+}
+
+template <typename T>
+inline void PoolAllocator<T>::deallocate(T* ptr, size_t count) {
+    if (count == 1)
+        ObjectPool<T>::Release(ptr);
+    else
+        ::operator delete(ptr);
+}
+
+template <typename T>
+template <typename U, typename... Args>
+inline void PoolAllocator<T>::construct(U* ptr, Args&&... args) {
+    ::new((void*)ptr) U(std::forward<Args>(args)...);
+}
+
+template <typename T>
+template <typename U>
+inline void PoolAllocator<T>::destroy(U* ptr) {
+    ptr->~U();
+}
+
+}
+
+#endif
\ No newline at end of file
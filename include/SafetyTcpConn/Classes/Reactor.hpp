@@ -0,0 +1,210 @@
+#ifndef STC_REACTOR_HPP
+#define STC_REACTOR_HPP
+
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <signal.h>
+#include <pthread.h>
+
+#include "Classes.hpp"
+#include "TimerWheel.hpp"
+#include "ContainerTable.hpp"
+#include "IoUring.hpp"
+
+namespace SafetyTcpConn {
+
+class Reactor {
+private:
+    friend class Core;
+    friend class Endpoint;
+    friend class Connection;
+
+    static constexpr uint64_t kTickMs = 10;
+
+    // a closed connection waits this long for its zero-copy sends to complete before its socket is reset
+    static constexpr uint64_t kLingerMs = 30000;
+
+    // epoll key of the wake up eventfd, keys of containers are never 0
+    static constexpr uint64_t kWakeKey = 0;
+
+    // sizes of io_uring backend, buffer count must be a power of 2
+    static constexpr unsigned kUringEntries     = 512;
+    static constexpr unsigned kUringBufCount    = 512;
+    static constexpr unsigned kUringBufSize     = 4096;
+
+    // kinds of io_uring operations, kept in the low bits of user_data
+    static constexpr uint64_t kUringOpWake      = 0;
+    static constexpr uint64_t kUringOpAccept    = 1;
+    static constexpr uint64_t kUringOpRecv      = 2;
+    static constexpr uint64_t kUringOpSend      = 3;
+    static constexpr uint64_t kUringOpConnect   = 4;
+    static constexpr uint64_t kUringOpListen    = 5;
+    static constexpr uint64_t kUringOpCancel    = 6;
+    static constexpr uint64_t kUringOpMask      = 7;
+
+    Core*               m_core_;
+    const size_t        m_index_;
+    Backend             m_backend_;
+    std::atomic_bool    m_open_;
+    std::atomic_size_t  m_conn_count_;
+
+    int m_epoll_fd_;
+    std::thread m_epoll_thread_;
+    std::thread m_send_thread_;
+
+    // fd to container table, looked up by the epoll thread without locking
+    ContainerTable m_containers_;
+
+    // eventfd waking up the epoll thread, watched by epoll or read by io_uring
+    int m_wake_fd_;
+
+    // connections closed by other threads, unregistered by the epoll thread once woken up
+    std::mutex m_mtx_closed_;
+    std::vector<ConnectionPtr> m_closed_;
+
+    // unregistered connections with zero-copy sends not completed and when they are given up, only touched by the epoll thread
+    std::vector<std::pair<ConnectionPtr, uint64_t>> m_lingering_;
+    uint64_t m_linger_check_ms_;
+
+    // intrusive list of connections ready to send, linked by `Connection::m_send_next_`
+    std::mutex m_mtx_send_queue_;
+    std::condition_variable m_cond_send_queue_;
+    ConnectionPtr m_send_head_;
+    Connection* m_send_tail_;
+
+    // timers of connections, driven by the epoll thread
+    std::mutex m_mtx_timer_;
+    TimerWheel m_timer_wheel_;
+
+#ifdef STC_HAS_IO_URING
+    // io_uring backend, the ring is only touched by the epoll thread
+    IoUring m_uring_;
+    uint64_t m_wake_value_;
+    // containers waiting for their first operation, guarded by m_mtx_send_queue_
+    std::vector<ContainerPtr> m_uring_pending_;
+    // containers with operations in flight, they must stay alive until the operations complete
+    std::unordered_map<Container*, ContainerPtr> m_uring_holds_;
+#endif
+private:
+    Reactor(Core* core, size_t index, Backend backend);
+
+public:
+    ~Reactor();
+
+private:
+    void RegisterContainer(ContainerPtr& container);
+
+    /// @param expected only unregister when the fd still belongs to this container, the fd may be reused after closing
+    void UnregisterContainer(const int container_fd, const Container* expected = nullptr);
+
+    /// @brief Hand a closed connection to the epoll thread and wake it up, it unregisters the connection and closes the fd.
+    void PostClose(const ConnectionPtr& conn);
+
+    /// @brief Unregister connections posted by `PostClose` and close their fds.
+    void RemoveClosed();
+
+    /// @brief Close the fds of lingering connections once their zero-copy sends are completed, checked once a tick.
+    /// @param stopping close them all now, the reactor is stopped
+    void ReapLingering(const bool stopping);
+
+    /// @brief Wake up the epoll thread waiting for events.
+    void Wake();
+
+    /// @brief Run the process function of the connection, on the worker pool when the core has one, otherwise right here.
+    void Process(const ConnectionPtr& conn);
+
+    /// @brief Run the cleanup function of a closed connection, after its process functions queued in the worker pool.
+    void Cleanup(const ConnectionPtr& conn);
+
+    /// @brief Apply the readiness of one epoll event to the connection, writable, readable and closing are handled independently.
+    /// @note Connections are edge-triggered, every readiness in the event is reported once only.
+    void HandleEvents(const ConnectionPtr& conn, uint32_t events);
+
+    /// @brief The peer of the connection has finished sending, close it once all input is processed and the replies are sent.
+    void HalfClose(const ConnectionPtr& conn);
+
+    /// @brief Finish the connect of an outbound connection, run its init function and send the messages enqueued while connecting.
+    /// @return `bool`: established(`true`) / failed, the connection is unregistered(`false`)
+    bool CompleteConnect(const ConnectionPtr& conn);
+
+    /// @brief Watch the source of a relay with nothing to read, `Connection::ResumeRelay` runs once it is readable.
+    /// @note Only for the epoll backend. The source is put into the container table as the connection, its events are told apart by the fd.
+    /// @return `bool`: watched(`true`) / the fd can't be watched(`false`)
+    bool WatchRelay(const ConnectionPtr& conn, const int src_fd);
+
+    /// @brief Stop watching the source of a relay, before it is closed.
+    void UnwatchRelay(Connection* conn, const int src_fd);
+
+    /// @brief Stop waiting for the source of the relay of a closed connection, the wait of io_uring is cancelled.
+    void StopRelay(const ConnectionPtr& conn);
+
+    /// @brief Append the connection to the send ready-list and wake up the send thread.
+    /// @note A connection which is already in the list will not be appended twice.
+    void ScheduleSend(const ConnectionPtr& conn);
+
+    /// @brief Append connections to the send ready-list with one lock and one wake up.
+    void ScheduleSend(const std::vector<ConnectionPtr>& conns);
+    void Stop();
+
+    /// @brief Arm the timer of `type` of the connection to expire at `expire_ms`.
+    /// @param keep_armed keep the old expire time if the timer is armed already
+    void ArmTimer(Connection* conn, const TimeoutType type, const uint64_t expire_ms, const bool keep_armed);
+    void CancelTimer(Connection* conn, const TimeoutType type);
+
+    /// @brief Cancel all timers of the connection and never arm them again, called when unregistering.
+    void CloseTimers(Connection* conn);
+
+    /// @brief Hand expired timers to their connections.
+    void CheckTimers();
+
+    /// @brief Get current milliseconds of steady clock
+    static uint64_t NowMs();
+
+    /// @brief Block `SIGPIPE` in the calling thread, `sendfile` and `splice` have no `MSG_NOSIGNAL`
+    static void BlockSigpipe();
+
+private:
+    static void EpollLoop(Reactor* reactor);
+    static void SendLoop(Reactor* reactor);
+
+#ifdef STC_HAS_IO_URING
+    /// @brief Create the ring.
+    /// @return `bool`: io_uring is ready(`true`) / not supported, use epoll instead(`false`)
+    bool InitUring();
+
+    /// @brief Hand a container to the epoll thread, its first operation is submitted from there.
+    void QueueUring(const ContainerPtr& container);
+
+    void SubmitWake();
+    void SubmitAccept(const EndpointPtr& endpoint);
+
+    /// @brief Wait for a connection to be pending before accepting again, an accept out of fds fails at once even when none is.
+    void SubmitListen(const EndpointPtr& endpoint);
+    void SubmitRecv(const ConnectionPtr& conn);
+    void SubmitSend(const ConnectionPtr& conn);
+
+    /// @brief Wait for the socket of an outbound connection to become writable, which ends its connect.
+    void SubmitConnect(const ConnectionPtr& conn);
+
+    /// @brief Drop the reference of a closed connection when it has no operation in flight.
+    void ReleaseUring(const ConnectionPtr& conn);
+
+    void HandleCqe(const io_uring_cqe& cqe);
+
+    /// @brief Same as `EpollLoop` and `SendLoop` together, but events, receiving and sending are all completions of one ring.
+    static void UringLoop(Reactor* reactor);
+#endif
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,951 @@
+#ifndef STC_REACTOR_FUNC_HPP
+#define STC_REACTOR_FUNC_HPP
+
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "Classes.hpp"
+#include "Reactor.hpp"
+#include "Endpoint.hpp"
+#include "WorkerPool.hpp"
+
+namespace SafetyTcpConn {
+
+Reactor::Reactor(Core* core, size_t index, Backend backend) : m_core_(core), m_index_(index), m_backend_(Backend::kEpoll), m_open_(true), m_conn_count_(0), m_linger_check_ms_(0), m_send_tail_(nullptr), m_timer_wheel_(NowMs() / kTickMs) {
+    if ((m_epoll_fd_ = epoll_create(1)) == -1) {
+        std::cout << "SafetyTcpConn >> Reactor >> Error >> Can't create Epoll" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // other threads wake up the epoll thread with it, e.g. after closing a connection
+    if ((m_wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+        std::cout << "SafetyTcpConn >> Reactor >> Error >> Can't create Eventfd" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+#ifdef STC_HAS_IO_URING
+    m_wake_value_ = 0;
+
+    if (backend == Backend::kIoUring) {
+        if (InitUring())
+            m_backend_ = Backend::kIoUring;
+        else
+            std::cout << "SafetyTcpConn >> Reactor >> io_uring Not Supported, Use Epoll | Reactor: " << m_index_ << std::endl;
+    }
+#else
+    if (backend == Backend::kIoUring)
+        std::cout << "SafetyTcpConn >> Reactor >> io_uring Not Built, Use Epoll | Reactor: " << m_index_ << std::endl;
+#endif
+
+#ifdef STC_HAS_IO_URING
+    if (m_backend_ == Backend::kIoUring) {
+        std::cout << "SafetyTcpConn >> Reactor >> io_uring Create Success | Reactor: " << m_index_ << std::endl;
+        m_epoll_thread_ = std::thread(UringLoop, this);
+        return;
+    }
+#endif
+
+    epoll_event wake_event{};
+    wake_event.events = EPOLLIN;
+    wake_event.data.u64 = kWakeKey;
+    epoll_ctl(m_epoll_fd_, EPOLL_CTL_ADD, m_wake_fd_, &wake_event);
+
+    std::cout << "SafetyTcpConn >> Reactor >> Epoll Create Success | Reactor: " << m_index_ << " | Epoll FD: " << m_epoll_fd_ << std::endl;
+    m_epoll_thread_ = std::thread(EpollLoop, this);
+    m_send_thread_ = std::thread(SendLoop, this);
+}
+
+Reactor::~Reactor() {
+    Stop();
+    close(m_epoll_fd_);
+
+#ifdef STC_HAS_IO_URING
+    // operations in flight are cancelled and reaped, only then the containers they use are released
+    m_uring_.Close();
+    m_uring_holds_.clear();
+    m_uring_pending_.clear();
+#endif
+    close(m_wake_fd_);
+
+    // posted after the epoll thread ended
+    for (size_t i = 0; i < m_closed_.size(); i++)
+        m_closed_[i]->CloseFd();
+    m_closed_.clear();
+    ReapLingering(true);
+
+    std::cout << "SafetyTcpConn >> Reactor >> Safety Clean | Reactor: " << m_index_ << " | Epoll FD: " << m_epoll_fd_ << std::endl;
+}
+
+inline void Reactor::Stop() {
+    m_open_.store(false);
+
+    // wake up send thread
+    {
+        std::unique_lock<std::mutex> lck(m_mtx_send_queue_);
+        m_cond_send_queue_.notify_one();
+    }
+
+    // wake up epoll thread
+    Wake();
+
+    if (m_epoll_thread_.joinable())
+        m_epoll_thread_.join();
+    if (m_send_thread_.joinable())
+        m_send_thread_.join();
+}
+
+void Reactor::RegisterContainer(ContainerPtr& container) {
+    if (container.get() == nullptr)
+        return;
+
+    container->m_reactor_ = this;
+
+    if (container->m_type_ == ContainerType::kEndpoint) {
+        EndpointPtr endpoint = std::static_pointer_cast<Endpoint>(container);
+
+        // the listener this reactor watches, assigned by core
+        const int listen_fd = endpoint->ListenFd(this);
+        if (listen_fd < 0)
+            return;
+
+        const uint64_t key = m_containers_.Insert(listen_fd, container);
+
+#ifdef STC_HAS_IO_URING
+        if (m_backend_ == Backend::kIoUring) {
+            QueueUring(container);
+            return;
+        }
+#endif
+
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = key;
+        epoll_ctl(m_epoll_fd_, EPOLL_CTL_ADD, listen_fd, &event);
+    }
+    else {
+        ConnectionPtr conn = std::static_pointer_cast<Connection>(container);
+
+        // add into container table
+        const uint64_t key = m_containers_.Insert(conn->m_fd_, container);
+        if (key == 0) {
+            std::cerr << "SafetyTcpConn >> Reactor >> Error >> FD Out Of Container Table Range | FD: " << conn->m_fd_ << std::endl;
+            conn->SetClosed();
+            EndpointPtr endpoint = conn->m_endpoint_.lock();
+            if (endpoint != nullptr)
+                Endpoint::Remove(endpoint, conn->m_fd_);
+            conn->CloseFd();
+            return;
+        }
+        m_conn_count_.fetch_add(1);
+
+        const uint32_t idle_timeout_ms = conn->m_timeouts_[(int)TimeoutType::kIdle].load();
+        if (idle_timeout_ms > 0)
+            ArmTimer(conn.get(), TimeoutType::kIdle, NowMs() + idle_timeout_ms, false);
+
+        // an outbound connection runs its init function once established
+        if (conn->IsConnecting()) {
+            const uint32_t connect_timeout_ms = conn->m_timeouts_[(int)TimeoutType::kConnect].load();
+            if (connect_timeout_ms > 0)
+                ArmTimer(conn.get(), TimeoutType::kConnect, NowMs() + connect_timeout_ms, false);
+        }
+        // run connection init function before subscribing,
+        // the epoll thread of this reactor may not be the one that accepted the connection
+        else {
+            conn->m_funcs_->m_coninit_func_(conn);
+        }
+
+#ifdef STC_HAS_IO_URING
+        if (m_backend_ == Backend::kIoUring)
+            QueueUring(container);
+        else
+#endif
+        {
+            // epoll subscribe to client
+            epoll_event client_event{};
+            client_event.events = EPOLLIN | EPOLLOUT | EPOLLERR | EPOLLHUP | EPOLLRDHUP | EPOLLET;
+            client_event.data.u64 = key;
+            epoll_ctl(m_epoll_fd_, EPOLL_CTL_ADD, conn->m_fd_, &client_event);
+        }
+
+        // closed before now, e.g. by its init function, it was not posted since the fd must stay open until subscribed
+        conn->m_registered_.store(true);
+        if (!conn->IsConn())
+            PostClose(conn);
+    }
+}
+
+void Reactor::UnregisterContainer(const int container_fd, const Container* expected) {
+    // remove from container table, nothing when the fd is reused by another container already
+    ContainerPtr container = m_containers_.Remove(container_fd, expected);
+    if (container == nullptr)
+        return;
+
+    if (container->m_type_ == ContainerType::kEndpoint) {
+        EndpointPtr endpoint = std::static_pointer_cast<Endpoint>(container);
+
+        // unsubscribe from epoll, io_uring accept ends when the endpoint is closed
+        if (m_backend_ == Backend::kEpoll)
+            epoll_ctl(m_epoll_fd_, EPOLL_CTL_DEL, container_fd, nullptr);
+    }
+    else {
+        ConnectionPtr conn = std::static_pointer_cast<Connection>(container);
+        m_conn_count_.fetch_sub(1);
+        CloseTimers(conn.get());
+
+        // unsubscribe from epoll, io_uring operations end when the connection is closed
+        if (m_backend_ == Backend::kEpoll)
+            epoll_ctl(m_epoll_fd_, EPOLL_CTL_DEL, conn->m_fd_, nullptr);
+
+        // remove from endpoint, outbound connections have none
+        EndpointPtr endpoint = conn->m_endpoint_.lock();
+        if (endpoint != nullptr)
+            Endpoint::Remove(endpoint, conn->m_fd_);
+
+        // closed before established
+        if (conn->IsConnecting())
+            Metrics::Add(MetricCounter::kConnectFailures);
+
+        // close connection and run cleanup function
+        conn->SetClosed();
+        StopRelay(conn);
+        // the kernel may still read the buffers of zero-copy sends, the fd stays open to read their completions
+        if (conn->Linger())
+            m_lingering_.emplace_back(conn, NowMs() + kLingerMs);
+        else
+            conn->CloseFd();
+        Cleanup(conn);
+
+#ifdef STC_HAS_IO_URING
+        // no operation in flight holds it any more, e.g. its recv ended when the peer finished sending
+        if (m_backend_ == Backend::kIoUring)
+            ReleaseUring(conn);
+#endif
+    }
+}
+
+inline bool Reactor::WatchRelay(const ConnectionPtr& conn, const int src_fd) {
+    // the source is owned by the send queue of `conn` until unwatched, so no other container has its fd
+    const uint64_t key = m_containers_.Insert(src_fd, conn);
+    if (key == 0)
+        return false;
+
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.u64 = key;
+    if (epoll_ctl(m_epoll_fd_, EPOLL_CTL_ADD, src_fd, &event) < 0) {
+        m_containers_.Remove(src_fd, conn.get());
+        return false;
+    }
+    return true;
+}
+
+inline void Reactor::UnwatchRelay(Connection* conn, const int src_fd) {
+    // the caller may hold another fd of the source, epoll would keep watching it after closing ours
+    epoll_ctl(m_epoll_fd_, EPOLL_CTL_DEL, src_fd, nullptr);
+    m_containers_.Remove(src_fd, conn);
+}
+
+inline void Reactor::StopRelay(const ConnectionPtr& conn) {
+    std::unique_lock<std::mutex> lck(conn->m_send_buff_mtx_);
+    if (conn->m_relay_wait_fd_ < 0)
+        return;
+
+#ifdef STC_HAS_IO_URING
+    // the poll on the source may never complete, cancel it so that the connection is released
+    if (m_backend_ == Backend::kIoUring && conn->m_uring_sending_) {
+        io_uring_sqe* sqe = m_uring_.GetSqe();
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = reinterpret_cast<uint64_t>(conn.get()) | kUringOpSend;
+        sqe->user_data = kUringOpCancel;
+    }
+#endif
+    conn->UnwatchRelay();
+}
+
+inline void Reactor::Process(const ConnectionPtr& conn) {
+    WorkerPool* workers = m_core_->m_workers_;
+    if (workers != nullptr) {
+        workers->Post(conn);
+        return;
+    }
+
+    const uint64_t start_us = Metrics::NowUs();
+    conn->m_funcs_->m_process_func_(conn);
+    Metrics::Record(MetricHistogram::kCallbackUs, Metrics::NowUs() - start_us);
+    conn->UpdateReadTimer();
+}
+
+inline void Reactor::Cleanup(const ConnectionPtr& conn) {
+    WorkerPool* workers = m_core_->m_workers_;
+    if (workers != nullptr) {
+        workers->PostCleanup(conn);
+        return;
+    }
+
+    conn->m_funcs_->m_cleanup_func_(conn);
+}
+
+inline void Reactor::HandleEvents(const ConnectionPtr& conn, uint32_t events) {
+    // zero-copy completions are reported as errors, the connection is broken only by a real one
+    if ((events & EPOLLERR) && conn->m_policy_->m_zerocopy_threshold_ > 0 && conn->ReadErrorQueue())
+        events &= ~EPOLLERR;
+
+    // error, nothing can be sent or received any more
+    if (events & EPOLLERR) {
+        UnregisterContainer(conn->m_fd_, conn.get());
+        return;
+    }
+
+    // available to send, whatever else comes with it, or the edge is lost until the send stall timer closes it
+    if (events & EPOLLOUT) {
+        conn->SetSendFlag();
+        if (conn->NeedSend())
+            ScheduleSend(conn);
+    }
+
+    // data receive, or the peer has finished sending, read until nothing is left so the input before the end is processed too
+    if ((events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) && !conn->IsPeerClosed()) {
+        bool peer_closed = false;
+        if (conn->TryRecv(peer_closed))
+            Process(conn);
+        if (peer_closed)
+            HalfClose(conn);
+    }
+}
+
+inline void Reactor::HalfClose(const ConnectionPtr& conn) {
+    conn->m_peer_closed_.store(true);
+
+    // processed right here already, or the worker pool closes it after the last run of its strand
+    if (m_core_->m_workers_ == nullptr || conn->m_strand_pending_.load() == 0)
+        conn->CloseWhenDrained();
+}
+
+inline bool Reactor::CompleteConnect(const ConnectionPtr& conn) {
+    if (!conn->FinishConnect()) {
+        UnregisterContainer(conn->m_fd_, conn.get());
+        return false;
+    }
+    CancelTimer(conn.get(), TimeoutType::kConnect);
+
+    conn->m_funcs_->m_coninit_func_(conn);
+
+    // sendable from now on, messages enqueued while connecting are waiting
+    conn->SetSendFlag();
+    if (conn->NeedSend())
+        ScheduleSend(conn);
+    return true;
+}
+
+inline void Reactor::ScheduleSend(const ConnectionPtr& conn) {
+    // already in the ready-list
+    if (conn->m_send_queued_.exchange(true))
+        return;
+
+    std::unique_lock<std::mutex> lck(m_mtx_send_queue_);
+    const bool was_empty = m_send_tail_ == nullptr;
+    if (was_empty)
+        m_send_head_ = conn;
+    else
+        m_send_tail_->m_send_next_ = conn;
+    m_send_tail_ = conn.get();
+
+#ifdef STC_HAS_IO_URING
+    // the epoll thread takes the whole list, only wake it up for the first one
+    if (m_backend_ == Backend::kIoUring) {
+        if (was_empty)
+            Wake();
+        return;
+    }
+#endif
+
+    m_cond_send_queue_.notify_one();
+}
+
+inline void Reactor::ScheduleSend(const std::vector<ConnectionPtr>& conns) {
+    std::unique_lock<std::mutex> lck(m_mtx_send_queue_);
+    const bool was_empty = m_send_tail_ == nullptr;
+    for (size_t i = 0; i < conns.size(); i++) {
+        const ConnectionPtr& conn = conns[i];
+
+        // already in the ready-list
+        if (conn->m_send_queued_.exchange(true))
+            continue;
+
+        if (m_send_tail_ == nullptr)
+            m_send_head_ = conn;
+        else
+            m_send_tail_->m_send_next_ = conn;
+        m_send_tail_ = conn.get();
+    }
+
+#ifdef STC_HAS_IO_URING
+    if (m_backend_ == Backend::kIoUring) {
+        if (was_empty && m_send_tail_ != nullptr)
+            Wake();
+        return;
+    }
+#endif
+
+    m_cond_send_queue_.notify_one();
+}
+
+inline void Reactor::ArmTimer(Connection* conn, const TimeoutType type, const uint64_t expire_ms, const bool keep_armed) {
+    std::unique_lock<std::mutex> lck(m_mtx_timer_);
+    if (conn->m_timer_closed_)
+        return;
+
+    TimerNode* node = conn->GetTimer(type);
+    if (node == nullptr || (keep_armed && node->IsLinked()))
+        return;
+
+    // round up, never fire earlier than expected
+    m_timer_wheel_.Schedule(node, (expire_ms + kTickMs - 1) / kTickMs);
+}
+
+inline void Reactor::CancelTimer(Connection* conn, const TimeoutType type) {
+    std::unique_lock<std::mutex> lck(m_mtx_timer_);
+    TimerNode* node = conn->GetTimer(type);
+    if (node != nullptr)
+        m_timer_wheel_.Cancel(node);
+}
+
+inline void Reactor::CloseTimers(Connection* conn) {
+    std::unique_lock<std::mutex> lck(m_mtx_timer_);
+    conn->m_timer_closed_ = true;
+    for (int i = 0; i < (int)TimeoutType::kCount; i++)
+        m_timer_wheel_.Cancel(conn->GetTimer((TimeoutType)i));
+}
+
+inline void Reactor::CheckTimers() {
+    std::vector<std::pair<ConnectionPtr, TimeoutType>> expired;
+    {
+        std::unique_lock<std::mutex> lck(m_mtx_timer_);
+        if (m_timer_wheel_.Size() == 0)
+            return;
+
+        // an armed timer means the connection is still registered, so it is safe to get a ConnectionPtr
+        m_timer_wheel_.Advance(NowMs() / kTickMs, [&expired](TimerNode* node) {
+            expired.emplace_back(node->m_conn_->shared_from_this(), node->m_type_);
+        });
+    }
+
+    for (size_t i = 0; i < expired.size(); i++)
+        expired[i].first->HandleTimeout(expired[i].second);
+}
+
+inline void Reactor::PostClose(const ConnectionPtr& conn) {
+    bool was_empty = false;
+    {
+        std::unique_lock<std::mutex> lck(m_mtx_closed_);
+        was_empty = m_closed_.empty();
+        m_closed_.push_back(conn);
+    }
+
+    // the epoll thread takes the whole list, only wake it up for the first one
+    if (was_empty)
+        Wake();
+}
+
+inline void Reactor::RemoveClosed() {
+    std::vector<ConnectionPtr> closed;
+    {
+        std::unique_lock<std::mutex> lck(m_mtx_closed_);
+        if (m_closed_.empty())
+            return;
+        closed.swap(m_closed_);
+    }
+
+    // run normal cleanup funtion, the fd is closed after unregistering so that it is not reused before
+    for (size_t i = 0; i < closed.size(); i++) {
+        UnregisterContainer(closed[i]->m_fd_, closed[i].get());
+        closed[i]->CloseFd();
+    }
+}
+
+inline void Reactor::ReapLingering(const bool stopping) {
+    const uint64_t now = NowMs();
+    if (m_lingering_.empty() || (!stopping && now < m_linger_check_ms_))
+        return;
+    m_linger_check_ms_ = now + kTickMs;
+
+    size_t kept = 0;
+    for (size_t i = 0; i < m_lingering_.size(); i++) {
+        // a peer which never acknowledges can't keep the buffers forever
+        const bool abort = stopping || now >= m_lingering_[i].second;
+        if (!m_lingering_[i].first->FinishLinger(abort))
+            m_lingering_[kept++] = std::move(m_lingering_[i]);
+    }
+    m_lingering_.resize(kept);
+}
+
+inline void Reactor::Wake() {
+    const uint64_t value = 1;
+    ssize_t written = write(m_wake_fd_, &value, sizeof(value));
+    (void)written;
+}
+
+inline uint64_t Reactor::NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void Reactor::BlockSigpipe() {
+    // a peer closed while sending raises it, the error is read from the failed call instead
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+}
+
+inline void Reactor::EpollLoop(Reactor* reactor) {
+    constexpr int kMaxEventSize = 32;
+    epoll_event epoll_events[kMaxEventSize];
+
+    int event_count = 0;
+    while (reactor->m_open_.load()) {
+        // no container found in the previous round is in use now
+        reactor->m_containers_.Reclaim();
+
+        // wake up every tick only when there are armed timers or lingering connections
+        int timeout_ms = 1000;
+        {
+            std::unique_lock<std::mutex> lck(reactor->m_mtx_timer_);
+            if (reactor->m_timer_wheel_.Size() > 0 || !reactor->m_lingering_.empty())
+                timeout_ms = kTickMs;
+        }
+
+        if ((event_count = epoll_wait(reactor->m_epoll_fd_, epoll_events, kMaxEventSize, timeout_ms)) == -1) {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "SafetyTcpConn >> Reactor >> Error >> Epoll Error!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        const uint64_t loop_start_us = Metrics::NowUs();
+
+        // fire expired timers, connections closed by them are cleaned up below
+        reactor->CheckTimers();
+
+        // remove connections closed by the user, timers or other threads
+        reactor->RemoveClosed();
+        reactor->ReapLingering(false);
+
+        for (int i = 0; i < event_count; i++) {
+            // the key carries the generation, an event of a removed container never finds the one reusing its fd
+            const uint64_t key = epoll_events[i].data.u64;
+
+            // woken up by other threads, read the eventfd before taking the closed ones so that no wake up is lost
+            if (key == kWakeKey) {
+                uint64_t value = 0;
+                ssize_t count = read(reactor->m_wake_fd_, &value, sizeof(value));
+                (void)count;
+                reactor->RemoveClosed();
+                continue;
+            }
+
+            const int target_fd = (int)(uint32_t)key;
+            Container* container = reactor->m_containers_.Find(key);
+            if (container == nullptr)
+                continue;
+
+            // endpoint found, accept connections and hand them to the least loaded reactor
+            if (container->m_type_ == ContainerType::kEndpoint) {
+                EndpointPtr endpoint = static_cast<Endpoint*>(container)->shared_from_this();
+                Endpoint::Accept(endpoint, target_fd);
+            }
+            // connection found
+            else {
+                ConnectionPtr conn = static_cast<Connection*>(container)->shared_from_this();
+
+                // the source of its relay is readable, not the connection itself
+                if (target_fd != conn->m_fd_) {
+                    conn->ResumeRelay();
+                    continue;
+                }
+
+                // outbound connection established or failed, data of the same event is handled below
+                if (conn->IsConnecting() && !reactor->CompleteConnect(conn))
+                    continue;
+
+                reactor->HandleEvents(conn, epoll_events[i].events);
+            }
+        }
+
+        Metrics::Record(MetricHistogram::kLoopUs, Metrics::NowUs() - loop_start_us);
+        Metrics::Record(MetricHistogram::kEventBatch, event_count);
+    }
+
+    std::cout << "SafetyTcpConn >> Reactor >> Epoll Thread Ended | Reactor: " << reactor->m_index_ << std::endl;
+}
+
+inline void Reactor::SendLoop(Reactor* reactor) {
+    std::vector<ConnectionPtr> ready;
+    BlockSigpipe();
+
+    while (reactor->m_open_.load()) {
+        // take the whole ready-list
+        {
+            std::unique_lock<std::mutex> lck(reactor->m_mtx_send_queue_);
+            // nothing need to send, sleep until a connection become ready
+            while (reactor->m_send_head_ == nullptr && reactor->m_open_.load())
+                reactor->m_cond_send_queue_.wait(lck);
+
+            ConnectionPtr conn = std::move(reactor->m_send_head_);
+            while (conn != nullptr) {
+                ConnectionPtr next = std::move(conn->m_send_next_);
+                ready.push_back(std::move(conn));
+                conn = std::move(next);
+            }
+            reactor->m_send_tail_ = nullptr;
+        }
+
+        // call TrySend for connections in ready-list
+        for (size_t i = 0; i < ready.size(); i++) {
+            const ConnectionPtr& conn = ready[i];
+
+            // leave the list before sending, messages enqueued from now on will schedule it again
+            conn->m_send_queued_.store(false);
+
+            // sent messages until can't send
+            int quota = conn->m_policy_->m_send_quota_; // fair usage policy
+            int sent = 0;
+            while (quota-- > 0 && (sent = conn->TrySend()) > 0);
+
+            // quota used up, go to the end of the ready-list
+            if (sent > 0)
+                reactor->ScheduleSend(conn);
+            // unable to send currently, wait for EPOLLOUT, the send stall timer closes it if EPOLLOUT never comes
+            else if (sent < 0 && !conn->m_send_flag_.load()) {
+                const uint32_t timeout_ms = conn->m_timeouts_[(int)TimeoutType::kSendStall].load();
+                if (timeout_ms > 0) {
+                    const uint64_t now = NowMs();
+                    conn->m_stall_since_ms_.store(now);
+                    reactor->ArmTimer(conn.get(), TimeoutType::kSendStall, now + timeout_ms, true);
+                }
+            }
+        }
+        ready.clear();
+    }
+
+    std::cout << "SafetyTcpConn >> Reactor >> Send Thread Ended | Reactor: " << reactor->m_index_ << std::endl;
+}
+
+#ifdef STC_HAS_IO_URING
+
+inline bool Reactor::InitUring() {
+    return m_uring_.Init(kUringEntries, kUringBufCount, kUringBufSize, 0);
+}
+
+inline void Reactor::QueueUring(const ContainerPtr& container) {
+    {
+        std::unique_lock<std::mutex> lck(m_mtx_send_queue_);
+        m_uring_pending_.push_back(container);
+    }
+    Wake();
+}
+
+inline void Reactor::SubmitWake() {
+    io_uring_sqe* sqe = m_uring_.GetSqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = m_wake_fd_;
+    sqe->addr = reinterpret_cast<uint64_t>(&m_wake_value_);
+    sqe->len = sizeof(m_wake_value_);
+    sqe->user_data = kUringOpWake;
+}
+
+inline void Reactor::SubmitAccept(const EndpointPtr& endpoint) {
+    const int listen_fd = endpoint->ListenFd(this);
+    if (listen_fd < 0)
+        return;
+
+    m_uring_holds_[endpoint.get()] = endpoint;
+
+    // one multishot accept keeps accepting until the endpoint is closed
+    io_uring_sqe* sqe = m_uring_.GetSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = reinterpret_cast<uint64_t>(endpoint.get()) | kUringOpAccept;
+}
+
+inline void Reactor::SubmitListen(const EndpointPtr& endpoint) {
+    const int listen_fd = endpoint->ListenFd(this);
+    if (listen_fd < 0)
+        return;
+
+    m_uring_holds_[endpoint.get()] = endpoint;
+
+    io_uring_sqe* sqe = m_uring_.GetSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = listen_fd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = reinterpret_cast<uint64_t>(endpoint.get()) | kUringOpListen;
+}
+
+inline void Reactor::SubmitRecv(const ConnectionPtr& conn) {
+    m_uring_holds_[conn.get()] = conn;
+    conn->m_uring_inflight_++;
+
+    // one multishot recv keeps receiving into provided buffers until the connection is closed
+    io_uring_sqe* sqe = m_uring_.GetSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->m_fd_;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = m_uring_.BufferGroup();
+    sqe->user_data = reinterpret_cast<uint64_t>(conn.get()) | kUringOpRecv;
+}
+
+inline void Reactor::SubmitSend(const ConnectionPtr& conn) {
+    // one send in flight for each connection, the next one is submitted when it completes
+    if (conn->m_uring_sending_ || !conn->PrepareAsyncSend())
+        return;
+
+    conn->m_uring_sending_ = true;
+    conn->m_uring_inflight_++;
+
+    io_uring_sqe* sqe = m_uring_.GetSqe();
+    // a file or relay at the front, wait until writable and send it by `sendfile` / `splice` in `CompleteAsyncSend`
+    if (conn->m_uring_send_->m_msg_.msg_iovlen == 0) {
+        int wait_fd = -1;
+        {
+            std::unique_lock<std::mutex> lck(conn->m_send_buff_mtx_);
+            wait_fd = conn->m_relay_wait_fd_;
+        }
+        // or until the source of the relay is readable when it had nothing to read
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = wait_fd >= 0 ? wait_fd : conn->m_fd_;
+        sqe->poll32_events = wait_fd >= 0 ? POLLIN : POLLOUT;
+    }
+    else {
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = conn->m_fd_;
+        sqe->addr = reinterpret_cast<uint64_t>(&conn->m_uring_send_->m_msg_);
+        sqe->len = 1;
+        sqe->msg_flags = MSG_NOSIGNAL;
+    }
+    sqe->user_data = reinterpret_cast<uint64_t>(conn.get()) | kUringOpSend;
+}
+
+inline void Reactor::SubmitConnect(const ConnectionPtr& conn) {
+    m_uring_holds_[conn.get()] = conn;
+    conn->m_uring_inflight_++;
+
+    // the connect result is read from SO_ERROR once the socket is writable or failed
+    io_uring_sqe* sqe = m_uring_.GetSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = conn->m_fd_;
+    sqe->poll32_events = POLLOUT;
+    sqe->user_data = reinterpret_cast<uint64_t>(conn.get()) | kUringOpConnect;
+}
+
+inline void Reactor::ReleaseUring(const ConnectionPtr& conn) {
+    if (conn->m_uring_inflight_ == 0 && !conn->IsConn())
+        m_uring_holds_.erase(conn.get());
+}
+
+inline void Reactor::HandleCqe(const io_uring_cqe& cqe) {
+    const uint64_t op = cqe.user_data & kUringOpMask;
+    Container* target = reinterpret_cast<Container*>(cqe.user_data & ~kUringOpMask);
+    const bool more = cqe.flags & IORING_CQE_F_MORE;
+
+    // result of cancelling, the cancelled operation completes by itself
+    if (op == kUringOpCancel)
+        return;
+
+    // woken up by other threads
+    if (op == kUringOpWake) {
+        SubmitWake();
+        return;
+    }
+
+    // connection accepted, hand it to the least loaded reactor
+    if (op == kUringOpAccept) {
+        auto it = m_uring_holds_.find(target);
+        if (it == m_uring_holds_.end())
+            return;
+        EndpointPtr endpoint = std::static_pointer_cast<Endpoint>(it->second);
+
+        const bool out_of_fds = cqe.res == -EMFILE || cqe.res == -ENFILE;
+        if (cqe.res >= 0) {
+            ContainerPtr conn = Endpoint::Adopt(endpoint, cqe.res);
+            if (conn == nullptr)
+                close(cqe.res);
+            else
+                m_core_->RegisterContainer(conn);
+        }
+        // out of fds, drop the pending connection, accepting again waits until another one is pending
+        else if (out_of_fds) {
+            const int listen_fd = endpoint->ListenFd(this);
+            if (listen_fd >= 0)
+                endpoint->DropPending(listen_fd);
+        }
+
+        // accept ended, it ends for good only when the endpoint is closed
+        if (!more) {
+            if (!endpoint->IsOpen())
+                m_uring_holds_.erase(it);
+            else if (out_of_fds)
+                SubmitListen(endpoint);
+            else
+                SubmitAccept(endpoint);
+        }
+        return;
+    }
+
+    // a connection is pending again after out of fds
+    if (op == kUringOpListen) {
+        auto it = m_uring_holds_.find(target);
+        if (it == m_uring_holds_.end())
+            return;
+        EndpointPtr endpoint = std::static_pointer_cast<Endpoint>(it->second);
+
+        if (endpoint->IsOpen())
+            SubmitAccept(endpoint);
+        else
+            m_uring_holds_.erase(it);
+        return;
+    }
+
+    // the connection is held by m_uring_holds_ until its operations complete, so it is safe to get a ConnectionPtr
+    ConnectionPtr conn = static_cast<Connection*>(target)->shared_from_this();
+
+    if (op == kUringOpRecv) {
+        // data receive
+        if (cqe.res > 0 && (cqe.flags & IORING_CQE_F_BUFFER)) {
+            const unsigned short buf_id = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+            const bool received = conn->AsyncRecv(m_uring_.GetBuffer(buf_id), cqe.res);
+            m_uring_.RecycleBuffer(buf_id);
+
+            if (received)
+                Process(conn);
+        }
+        // the peer has finished sending, everything before is processed already
+        else if (cqe.res == 0) {
+            HalfClose(conn);
+        }
+        // error, running out of provided buffers only ends the recv
+        else if (cqe.res != -ENOBUFS) {
+            UnregisterContainer(conn->m_fd_, conn.get());
+        }
+
+        // recv ended, receive again while the connection is alive and the peer is still sending
+        if (!more) {
+            conn->m_uring_inflight_--;
+            if (conn->IsConn() && !conn->IsPeerClosed())
+                SubmitRecv(conn);
+            else
+                ReleaseUring(conn);
+        }
+    }
+    else if (op == kUringOpConnect) {
+        conn->m_uring_inflight_--;
+
+        // established, start receiving
+        if (CompleteConnect(conn))
+            SubmitRecv(conn);
+        else
+            ReleaseUring(conn);
+    }
+    else if (op == kUringOpSend) {
+        conn->m_uring_inflight_--;
+        conn->m_uring_sending_ = false;
+
+        // more messages are queued while sending
+        if (conn->CompleteAsyncSend(cqe.res))
+            SubmitSend(conn);
+        else
+            ReleaseUring(conn);
+    }
+}
+
+inline void Reactor::UringLoop(Reactor* reactor) {
+    std::vector<ContainerPtr> pending;
+    std::vector<ConnectionPtr> ready;
+    BlockSigpipe();
+
+    reactor->SubmitWake();
+
+    // the loop work is timed from the end of one wait to the start of the next
+    uint64_t loop_start_us = Metrics::NowUs();
+    while (reactor->m_open_.load()) {
+        // no container found in the previous round is in use now
+        reactor->m_containers_.Reclaim();
+
+        // take new containers and the whole send ready-list
+        {
+            std::unique_lock<std::mutex> lck(reactor->m_mtx_send_queue_);
+            pending.swap(reactor->m_uring_pending_);
+
+            ConnectionPtr conn = std::move(reactor->m_send_head_);
+            while (conn != nullptr) {
+                ConnectionPtr next = std::move(conn->m_send_next_);
+                ready.push_back(std::move(conn));
+                conn = std::move(next);
+            }
+            reactor->m_send_tail_ = nullptr;
+        }
+
+        for (size_t i = 0; i < pending.size(); i++) {
+            if (pending[i]->m_type_ == ContainerType::kEndpoint)
+                reactor->SubmitAccept(std::static_pointer_cast<Endpoint>(pending[i]));
+            else {
+                ConnectionPtr conn = std::static_pointer_cast<Connection>(pending[i]);
+                if (conn->IsConnecting())
+                    reactor->SubmitConnect(conn);
+                else
+                    reactor->SubmitRecv(conn);
+            }
+        }
+        pending.clear();
+
+        // submit sends of ready connections, they go to the kernel together in the io_uring_enter below
+        for (size_t i = 0; i < ready.size(); i++) {
+            // leave the list before sending, messages enqueued from now on will schedule it again
+            ready[i]->m_send_queued_.store(false);
+            reactor->SubmitSend(ready[i]);
+        }
+        ready.clear();
+
+        // fire expired timers, and remove connections closed by the user, timers or other threads
+        reactor->CheckTimers();
+        reactor->RemoveClosed();
+
+        // wake up every tick only when there are armed timers
+        int timeout_ms = 1000;
+        {
+            std::unique_lock<std::mutex> lck(reactor->m_mtx_timer_);
+            if (reactor->m_timer_wheel_.Size() > 0)
+                timeout_ms = kTickMs;
+        }
+
+        Metrics::Record(MetricHistogram::kLoopUs, Metrics::NowUs() - loop_start_us);
+
+        // submit all prepared operations and wait for completions with one syscall
+        if (reactor->m_uring_.Submit(1, timeout_ms) < 0 && errno != EINTR && errno != ETIME && errno != EBUSY && errno != EAGAIN) {
+            std::cerr << "SafetyTcpConn >> Reactor >> Error >> io_uring Error!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        loop_start_us = Metrics::NowUs();
+
+        const unsigned cqe_count = reactor->m_uring_.ForEachCqe([reactor](const io_uring_cqe& cqe) {
+            reactor->HandleCqe(cqe);
+        });
+        Metrics::Record(MetricHistogram::kEventBatch, cqe_count);
+    }
+
+    // nothing may write into the provided buffers or read the send messages once the ring is closed
+    reactor->m_uring_.CancelAll();
+
+    std::cout << "SafetyTcpConn >> Reactor >> io_uring Thread Ended | Reactor: " << reactor->m_index_ << std::endl;
+}
+
+#endif
+
+}
+
+#endif
\ No newline at end of file
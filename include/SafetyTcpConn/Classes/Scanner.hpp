@@ -0,0 +1,36 @@
+#ifndef STC_SCANNER_HPP
+#define STC_SCANNER_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #define STC_SCANNER_X86 1
+#endif
+
+namespace SafetyTcpConn {
+
+/// @brief Search helper for multi-byte delimiters.
+/// @note Candidates are filtered by comparing the first and the last byte of the delimiter on a whole vector of positions at once (AVX2: 32, SSE2: 16),
+/// only the positions matching both are compared in full. AVX2 is picked at runtime when the cpu supports it, otherwise SSE2 or the scalar fallback is used.
+class Scanner {
+public:
+    /// @brief Find the first `delimiter` in `data`.
+    /// @return `size_t`: index of the delimiter / `std::string::npos` when not found
+    static size_t Find(const char* data, const size_t size, const char* delimiter, const size_t delimiter_size);
+
+private:
+    static size_t FindScalar(const char* data, const size_t size, const char* delimiter, const size_t delimiter_size, size_t start);
+
+#ifdef STC_SCANNER_X86
+    static bool HasAvx2();
+    static size_t FindSse2(const char* data, const size_t size, const char* delimiter, const size_t delimiter_size);
+    static size_t FindAvx2(const char* data, const size_t size, const char* delimiter, const size_t delimiter_size);
+#endif
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,114 @@
+#ifndef STC_SCANNER_FUNC_HPP
+#define STC_SCANNER_FUNC_HPP
+
+#include <cstdint>
+
+#include "Scanner.hpp"
+
+namespace SafetyTcpConn {
+
+inline size_t Scanner::Find(const char* data, const size_t size, const char* delimiter, const size_t delimiter_size) {
+    if (delimiter_size == 0 || size < delimiter_size)
+        return std::string::npos;
+
+    // single byte delimiter, libc memchr is already vectorized
+    if (delimiter_size == 1) {
+        const char* found = static_cast<const char*>(std::memchr(data, delimiter[0], size));
+        return found == nullptr ? std::string::npos : (size_t)(found - data);
+    }
+
+#ifdef STC_SCANNER_X86
+    if (HasAvx2())
+        return FindAvx2(data, size, delimiter, delimiter_size);
+    #ifdef __SSE2__
+    return FindSse2(data, size, delimiter, delimiter_size);
+    #endif
+#endif
+
+    return FindScalar(data, size, delimiter, delimiter_size, 0);
+}
+
+inline size_t Scanner::FindScalar(const char* data, const size_t size, const char* delimiter, const size_t delimiter_size, size_t start) {
+    const size_t last_index = size - delimiter_size;
+
+    while (start <= last_index) {
+        // jump to the next candidate of the first byte
+        const char* found = static_cast<const char*>(std::memchr(data + start, delimiter[0], last_index - start + 1));
+        if (found == nullptr)
+            break;
+
+        start = found - data;
+        if (std::memcmp(found + 1, delimiter + 1, delimiter_size - 1) == 0)
+            return start;
+        start++;
+    }
+
+    return std::string::npos;
+}
+
+#ifdef STC_SCANNER_X86
+
+inline bool Scanner::HasAvx2() {
+    static const bool has_avx2 = []() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+    }();
+    return has_avx2;
+}
+
+#ifdef __SSE2__
+inline size_t Scanner::FindSse2(const char* data, const size_t size, const char* delimiter, const size_t delimiter_size) {
+    constexpr size_t kBlockSize = 16;
+
+    const __m128i first = _mm_set1_epi8(delimiter[0]);
+    const __m128i last = _mm_set1_epi8(delimiter[delimiter_size - 1]);
+    const size_t candidate_count = size - delimiter_size + 1;
+
+    size_t index = 0;
+    for (; index + kBlockSize <= candidate_count; index += kBlockSize) {
+        const __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + index));
+        const __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + index + delimiter_size - 1));
+
+        uint32_t mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last)));
+        while (mask != 0) {
+            const size_t bit = __builtin_ctz(mask);
+            if (std::memcmp(data + index + bit + 1, delimiter + 1, delimiter_size - 2) == 0)
+                return index + bit;
+            mask &= mask - 1;
+        }
+    }
+
+    return FindScalar(data, size, delimiter, delimiter_size, index);
+}
+#endif
+
+__attribute__((target("avx2")))
+inline size_t Scanner::FindAvx2(const char* data, const size_t size, const char* delimiter, const size_t delimiter_size) {
+    constexpr size_t kBlockSize = 32;
+
+    const __m256i first = _mm256_set1_epi8(delimiter[0]);
+    const __m256i last = _mm256_set1_epi8(delimiter[delimiter_size - 1]);
+    const size_t candidate_count = size - delimiter_size + 1;
+
+    size_t index = 0;
+    for (; index + kBlockSize <= candidate_count; index += kBlockSize) {
+        const __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + index));
+        const __m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + index + delimiter_size - 1));
+
+        uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last)));
+        while (mask != 0) {
+            const size_t bit = __builtin_ctz(mask);
+            if (std::memcmp(data + index + bit + 1, delimiter + 1, delimiter_size - 2) == 0)
+                return index + bit;
+            mask &= mask - 1;
+        }
+    }
+
+    return FindScalar(data, size, delimiter, delimiter_size, index);
+}
+
+#endif
+
+}
+
+#endif
\ No newline at end of file
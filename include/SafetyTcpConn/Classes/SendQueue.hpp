@@ -0,0 +1,176 @@
+#ifndef STC_SEND_QUEUE_HPP
+#define STC_SEND_QUEUE_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <deque>
+#include <map>
+#include <memory>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/types.h>
+#include <sys/sendfile.h>
+
+#include "Classes.hpp"
+#include "BufferPool.hpp"
+
+namespace SafetyTcpConn {
+
+/// @brief A queue of messages waiting to be sent.
+/// @note Messages are kept as separate buffers and handed to `sendmsg` as an iovec batch.
+/// Copied messages are written into blocks from `BufferPool`, and small ones are appended to the tail block,
+/// so a burst of tiny messages doesn't become a burst of tiny iovecs or allocations.
+/// Files and relays from pipes / sockets are queued as fds and sent by `sendfile` / `splice`, their bytes never enter user memory.
+class SendQueue {
+private:
+    class Item {
+    public:
+        char*       m_block_;           // pooled block of copied messages
+        size_t      m_block_capacity_;
+        size_t      m_block_size_;
+        MessagePtr  m_shared_;          // shared or moved in message, its bytes never move with the item
+        size_t      m_offset_;
+
+        // for files and relays, owned by the item
+        int         m_file_fd_;         // `-1` for messages in memory
+        off_t       m_file_offset_;     // where the file range starts
+        size_t      m_file_size_;
+        bool        m_relay_;           // `m_file_fd_` is a pipe or socket, moved by `splice` through `m_pipe_`
+        int         m_pipe_[2];         // created on the first `splice`
+        size_t      m_piped_;           // bytes in `m_pipe_` not sent yet
+        bool        m_dry_;             // the source had nothing to read on the last `SendFile`, the relay waits for it
+
+        // for zero-copy sends, the kernel may read the buffer until the send `m_zc_seq_` completes
+        bool        m_pinned_;
+        uint32_t    m_zc_seq_;
+
+        Item(char* block, size_t capacity) : m_block_(block), m_block_capacity_(capacity), m_block_size_(0), m_offset_(0), m_file_fd_(-1), m_pinned_(false) {};
+        Item(const MessagePtr& shared) : m_block_(nullptr), m_block_capacity_(0), m_block_size_(0), m_shared_(shared), m_offset_(0), m_file_fd_(-1), m_pinned_(false) {};
+        Item(int fd, off_t offset, size_t len, bool relay) :
+            m_block_(nullptr), m_block_capacity_(0), m_block_size_(0), m_offset_(0),
+            m_file_fd_(fd), m_file_offset_(offset), m_file_size_(len), m_relay_(relay), m_pipe_{-1, -1}, m_piped_(0), m_dry_(false), m_pinned_(false) {};
+
+        bool IsFile() const { return m_file_fd_ >= 0; };
+        const char* Data() const { return m_block_ != nullptr ? m_block_ : m_shared_->data(); };
+        size_t Size() const { return m_block_ != nullptr ? m_block_size_ : IsFile() ? m_file_size_ : m_shared_->size(); };
+    };
+
+    // created on the first message and released when the queue is drained, an idle queue holds no memory
+    std::unique_ptr<std::deque<Item>>   m_items_;
+    size_t              m_size_;
+    size_t              m_file_size_;   // part of `m_size_` queued as files and relays
+    // count of items from the front which may be read by an async send, they are never appended
+    size_t              m_frozen_;
+    // for zero-copy sends, sent items are kept here until the kernel is done with them,
+    // they are moved from `m_items_` but their bytes are in pooled blocks or shared messages, which stay where they are
+    std::unique_ptr<std::deque<Item>>   m_retained_;
+    uint32_t            m_zc_next_;     // id of the next zero-copy send, counted the same way as the kernel
+    uint32_t            m_zc_done_;     // all zero-copy sends before this id are completed
+    std::map<uint32_t, uint32_t>        m_zc_ranges_;   // completed ranges after `m_zc_done_`, reported out of order
+public:
+    /// @brief Moved messages not larger than this size will be merged into the tail block, it is also the smallest block size
+    static constexpr size_t kCoalesceSize = 4096;
+
+    SendQueue();
+    ~SendQueue();
+
+    SendQueue(const SendQueue&) = delete;
+    SendQueue& operator=(const SendQueue&) = delete;
+
+    /// @brief Get the count of bytes waiting to be sent, including files and relays
+    size_t Size() const;
+
+    /// @brief Get the count of bytes waiting to be sent which are held in memory
+    size_t MemorySize() const;
+
+    bool Empty() const;
+
+    /// @brief Copy a message to the end of queue
+    void Push(const char* data, const size_t len);
+
+    /// @brief Move a message to the end of queue without copying
+    /// @note Messages up to `kCoalesceSize` are copied into a pooled block instead, a short string keeps its bytes inside itself.
+    void Push(std::string&& data);
+
+    /// @brief Put a reference of a shared message to the end of queue without copying
+    void Push(const MessagePtr& data);
+
+    /// @brief Put `len` bytes of a file from `offset` to the end of queue, they are sent by `sendfile`
+    /// @param fd the queue takes it and closes it once sent
+    /// @note Sending fails with `EIO` when the file is shorter than the range.
+    void PushFile(const int fd, const off_t offset, const size_t len);
+
+    /// @brief Put a relay of `len` bytes from a pipe or socket to the end of queue, they are moved by `splice`
+    /// @param fd a pipe or socket, the queue takes it and closes it once relayed. It may be blocking, it is only read when readable
+    /// @note The relay ends early when `fd` reaches the end of stream or fails before `len` bytes.
+    void PushRelay(const int fd, const size_t len);
+
+    /// @brief Fill `iov` with the pending bytes from the front of queue, it stops at the first file or relay
+    /// @param max_iov_count size of `iov`
+    /// @param max_bytes maximum bytes described by the filled iovecs
+    /// @return `int`: count of filled iovecs
+    int Fill(iovec* iov, const int max_iov_count, const size_t max_bytes) const;
+
+    /// @brief Check if the front of queue is a file or a relay, which is sent by `SendFile` instead of `Fill`
+    bool FrontIsFile() const;
+
+    /// @brief Send the front file or relay to `sock_fd` with non-blocking mode, sent bytes are removed
+    /// @param max_bytes maximum bytes to send
+    /// @return `ssize_t`: count of sent bytes(`>0`) / it ended early and is removed(`0`) / failed, see errno(`-1`).
+    /// `EAGAIN` is either the socket being full or the source of a relay having nothing to read, see `RelayWaitFd`
+    ssize_t SendFile(const int sock_fd, const size_t max_bytes);
+
+    /// @brief Get the source of the front relay when it had nothing to read on the last `SendFile`
+    /// @return `int`: fd to wait for until readable / `-1` when the front is not a relay waiting for its source
+    int RelayWaitFd() const;
+
+    /// @brief Remove `len` sent bytes from the front of queue
+    void Consume(size_t len);
+
+    /// @brief Remove `len` bytes sent by a zero-copy send from the front of queue, their buffers are kept until `CompleteZeroCopy`
+    void ConsumeZeroCopy(const size_t len);
+
+    /// @brief Release the buffers of zero-copy sends from `lo` to `hi` which the kernel is done with
+    void CompleteZeroCopy(const uint32_t lo, const uint32_t hi);
+
+    /// @brief Get the count of buffers waiting for zero-copy sends to complete
+    /// @note The socket must stay open while it is not `0`, or be closed with an abortive close, before the queue is destroyed.
+    size_t Retained() const;
+
+    /// @brief Remove every queued item, the ones pinned by zero-copy sends which are not completed are retained
+    void Clear();
+
+    /// @brief Keep the queued buffers unchanged while an async send is reading them, new messages go to new items
+    void Freeze();
+
+    /// @brief The async send is done, queued buffers can be appended again
+    void Unfreeze();
+
+private:
+    /// @brief Check if `len` bytes can be merged into the tail block
+    bool CanCoalesce(const size_t len) const;
+
+    /// @brief Copy bytes to the end of the tail block, `CanCoalesce` must be checked first
+    void AppendTail(const char* data, const size_t len);
+
+    /// @brief Remove the front item and give its block back to the pool, close its fds.
+    /// An item pinned by a zero-copy send which is not completed is moved to the retained items instead.
+    void PopFront();
+
+    /// @brief Give the block of an item back to the pool, close its fds
+    void Release(Item& item);
+
+    /// @brief Check if the zero-copy send `seq` is completed
+    bool ZeroCopyDone(const uint32_t seq) const;
+
+    /// @brief Get the item list, create it if it doesn't exist
+    std::deque<Item>& Items();
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,342 @@
+#ifndef STC_SEND_QUEUE_FUNC_HPP
+#define STC_SEND_QUEUE_FUNC_HPP
+
+#include "SendQueue.hpp"
+
+namespace SafetyTcpConn {
+
+SendQueue::SendQueue() : m_size_(0), m_file_size_(0), m_frozen_(0), m_zc_next_(0), m_zc_done_(0) {
+}
+
+SendQueue::~SendQueue() {
+    Clear();
+
+    // the socket is closed after the completions are read or by an abortive close, the kernel holds none of them any more
+    while (m_retained_ != nullptr && !m_retained_->empty()) {
+        Release(m_retained_->front());
+        m_retained_->pop_front();
+    }
+}
+
+inline size_t SendQueue::Size() const {
+    return m_size_;
+}
+
+inline size_t SendQueue::MemorySize() const {
+    return m_size_ - m_file_size_;
+}
+
+inline bool SendQueue::Empty() const {
+    return m_size_ == 0;
+}
+
+inline void SendQueue::Push(const char* data, const size_t len) {
+    if (len == 0)
+        return;
+
+    if (!CanCoalesce(len)) {
+        // leave some room for the following small messages
+        size_t capacity = 0;
+        char* block = BufferPool::Instance().Allocate(len < kCoalesceSize ? kCoalesceSize : len, capacity);
+        Items().emplace_back(block, capacity);
+    }
+
+    AppendTail(data, len);
+}
+
+inline void SendQueue::Push(std::string&& data) {
+    const size_t len = data.size();
+    if (len == 0)
+        return;
+
+    // copying a small message is cheaper than an extra iovec or an owner
+    if (len <= kCoalesceSize) {
+        Push(data.data(), len);
+        return;
+    }
+
+    // a zero-copy send may pin it, the owner keeps its bytes in place when the item is moved to the retained ones
+    Items().emplace_back(std::make_shared<const std::string>(std::move(data)));
+    m_size_ += len;
+}
+
+inline void SendQueue::Push(const MessagePtr& data) {
+    if (data == nullptr || data->size() == 0)
+        return;
+
+    Items().emplace_back(data);
+    m_size_ += data->size();
+}
+
+inline void SendQueue::PushFile(const int fd, const off_t offset, const size_t len) {
+    if (len == 0) {
+        close(fd);
+        return;
+    }
+
+    Items().emplace_back(fd, offset, len, false);
+    m_size_ += len;
+    m_file_size_ += len;
+}
+
+inline void SendQueue::PushRelay(const int fd, const size_t len) {
+    if (len == 0) {
+        close(fd);
+        return;
+    }
+
+    Items().emplace_back(fd, 0, len, true);
+    m_size_ += len;
+    m_file_size_ += len;
+}
+
+inline int SendQueue::Fill(iovec* iov, const int max_iov_count, const size_t max_bytes) const {
+    int iov_count = 0;
+    size_t bytes = 0;
+    if (m_items_ == nullptr)
+        return 0;
+
+    for (auto it = m_items_->begin(); it != m_items_->end() && iov_count < max_iov_count && bytes < max_bytes; it++) {
+        // files are sent by `SendFile` when they reach the front
+        if (it->IsFile())
+            break;
+
+        size_t len = it->Size() - it->m_offset_;
+        if (len > max_bytes - bytes)
+            len = max_bytes - bytes;
+
+        iov[iov_count].iov_base = const_cast<char*>(it->Data() + it->m_offset_);
+        iov[iov_count].iov_len = len;
+        iov_count++;
+        bytes += len;
+    }
+
+    return iov_count;
+}
+
+inline bool SendQueue::FrontIsFile() const {
+    return m_items_ != nullptr && !m_items_->empty() && m_items_->front().IsFile();
+}
+
+inline ssize_t SendQueue::SendFile(const int sock_fd, const size_t max_bytes) {
+    Item& item = m_items_->front();
+    const size_t remain = item.Size() - item.m_offset_;
+    const size_t len = remain < max_bytes ? remain : max_bytes;
+
+    ssize_t sent = 0;
+    if (!item.m_relay_) {
+        off_t offset = item.m_file_offset_ + (off_t)item.m_offset_;
+        sent = sendfile(sock_fd, item.m_file_fd_, &offset, len);
+
+        // the file is shorter than the range, the rest can never be sent
+        if (sent == 0) {
+            errno = EIO;
+            return -1;
+        }
+    }
+    else {
+        if (item.m_pipe_[0] < 0 && pipe2(item.m_pipe_, O_NONBLOCK | O_CLOEXEC) < 0)
+            return -1;
+
+        // fill the pipe only when it is empty
+        if (item.m_piped_ == 0) {
+            // `SPLICE_F_NONBLOCK` doesn't keep a blocking socket from blocking, read it only when it is readable
+            pollfd pfd{};
+            pfd.fd = item.m_file_fd_;
+            pfd.events = POLLIN;
+            ssize_t piped = -1;
+            if (poll(&pfd, 1, 0) > 0)
+                piped = splice(item.m_file_fd_, nullptr, item.m_pipe_[1], nullptr, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            else
+                errno = EAGAIN;
+
+            // nothing to read at the moment, keep it until the source is readable
+            item.m_dry_ = piped < 0 && (errno == EAGAIN || errno == EINTR);
+            if (item.m_dry_) {
+                errno = EAGAIN;
+                return -1;
+            }
+
+            // the end of stream or failed, the rest can never be relayed
+            if (piped <= 0) {
+                PopFront();
+                return 0;
+            }
+            item.m_piped_ = piped;
+        }
+
+        sent = splice(item.m_pipe_[0], nullptr, sock_fd, nullptr, item.m_piped_, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (sent > 0)
+            item.m_piped_ -= sent;
+    }
+
+    if (sent > 0)
+        Consume(sent);
+    return sent;
+}
+
+inline int SendQueue::RelayWaitFd() const {
+    if (!FrontIsFile())
+        return -1;
+
+    const Item& item = m_items_->front();
+    return item.m_relay_ && item.m_dry_ ? item.m_file_fd_ : -1;
+}
+
+inline void SendQueue::Consume(size_t len) {
+    m_size_ -= len < m_size_ ? len : m_size_;
+
+    while (len > 0 && m_items_ != nullptr && !m_items_->empty()) {
+        Item& item = m_items_->front();
+        const size_t remain = item.Size() - item.m_offset_;
+
+        // part of the front message sent
+        if (len < remain) {
+            item.m_offset_ += len;
+            if (item.IsFile())
+                m_file_size_ -= len;
+            return;
+        }
+
+        len -= remain;
+        // fully sent, nothing is left for `PopFront` to take off the sizes
+        if (item.IsFile()) {
+            item.m_offset_ += remain;
+            m_file_size_ -= remain;
+        }
+        PopFront();
+    }
+}
+
+inline void SendQueue::ConsumeZeroCopy(const size_t len) {
+    // pin every item the send read from, the front one may be only partly sent
+    size_t pinned = 0;
+    for (auto it = m_items_->begin(); it != m_items_->end() && pinned < len; it++) {
+        it->m_pinned_ = true;
+        it->m_zc_seq_ = m_zc_next_;
+        pinned += it->Size() - it->m_offset_;
+    }
+    m_zc_next_++;
+
+    Consume(len);
+}
+
+inline void SendQueue::CompleteZeroCopy(const uint32_t lo, const uint32_t hi) {
+    // completions are usually reported in order, keep the rare out of order ones until the gap is filled
+    if (ZeroCopyDone(lo) || lo == m_zc_done_) {
+        if (!ZeroCopyDone(hi))
+            m_zc_done_ = hi + 1;
+        // the gap before the out of order ones may be filled now
+        auto it = m_zc_ranges_.begin();
+        while (it != m_zc_ranges_.end() && (ZeroCopyDone(it->first) || it->first == m_zc_done_)) {
+            if (!ZeroCopyDone(it->second))
+                m_zc_done_ = it->second + 1;
+            it = m_zc_ranges_.erase(it);
+        }
+    }
+    else {
+        m_zc_ranges_[lo] = hi;
+    }
+
+    // items are retained in the order of sends
+    while (m_retained_ != nullptr && !m_retained_->empty() && ZeroCopyDone(m_retained_->front().m_zc_seq_)) {
+        Release(m_retained_->front());
+        m_retained_->pop_front();
+    }
+    if (m_retained_ != nullptr && m_retained_->empty())
+        m_retained_.reset();
+}
+
+inline size_t SendQueue::Retained() const {
+    return m_retained_ != nullptr ? m_retained_->size() : 0;
+}
+
+inline void SendQueue::Clear() {
+    while (m_items_ != nullptr && !m_items_->empty())
+        PopFront();
+    m_size_ = 0;
+    m_file_size_ = 0;
+    m_frozen_ = 0;
+}
+
+inline void SendQueue::Freeze() {
+    m_frozen_ = m_items_ != nullptr ? m_items_->size() : 0;
+}
+
+inline void SendQueue::Unfreeze() {
+    m_frozen_ = 0;
+}
+
+inline bool SendQueue::CanCoalesce(const size_t len) const {
+    // items read by an async send must not change
+    if (m_items_ == nullptr || m_items_->size() <= m_frozen_)
+        return false;
+
+    // only pooled blocks are written, moved and shared messages are never written
+    const Item& tail = m_items_->back();
+    return tail.m_block_ != nullptr && tail.m_block_capacity_ - tail.m_block_size_ >= len;
+}
+
+inline void SendQueue::AppendTail(const char* data, const size_t len) {
+    Item& tail = m_items_->back();
+    std::memcpy(tail.m_block_ + tail.m_block_size_, data, len);
+    tail.m_block_size_ += len;
+    m_size_ += len;
+}
+
+inline void SendQueue::PopFront() {
+    Item& item = m_items_->front();
+
+    // a file or relay may be removed before it is fully sent, its rest is not waiting any more
+    if (item.IsFile()) {
+        const size_t remain = item.m_file_size_ - item.m_offset_;
+        m_size_ -= remain < m_size_ ? remain : m_size_;
+        m_file_size_ -= remain < m_file_size_ ? remain : m_file_size_;
+    }
+
+    // the kernel may still read it
+    if (item.m_pinned_ && !ZeroCopyDone(item.m_zc_seq_)) {
+        if (m_retained_ == nullptr)
+            m_retained_.reset(new std::deque<Item>());
+        m_retained_->push_back(std::move(item));
+    }
+    else {
+        Release(item);
+    }
+
+    m_items_->pop_front();
+    if (m_frozen_ > 0)
+        m_frozen_--;
+
+    // drained, release the item list too
+    if (m_items_->empty())
+        m_items_.reset();
+}
+
+inline void SendQueue::Release(Item& item) {
+    if (item.m_block_ != nullptr)
+        BufferPool::Instance().Release(item.m_block_, item.m_block_capacity_);
+
+    if (item.IsFile()) {
+        close(item.m_file_fd_);
+        if (item.m_pipe_[0] >= 0) {
+            close(item.m_pipe_[0]);
+            close(item.m_pipe_[1]);
+        }
+    }
+}
+
+inline bool SendQueue::ZeroCopyDone(const uint32_t seq) const {
+    // ids wrap around
+    return (int32_t)(seq - m_zc_done_) < 0;
+}
+
+inline std::deque<SendQueue::Item>& SendQueue::Items() {
+    if (m_items_ == nullptr)
+        m_items_.reset(new std::deque<Item>());
+    return *m_items_;
+}
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,88 @@
+#ifndef STC_TIMER_WHEEL_HPP
+#define STC_TIMER_WHEEL_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Classes.hpp"
+
+namespace SafetyTcpConn {
+
+enum class TimeoutType {
+    kSendStall, // unable to send for too long
+    kIdle,      // nothing sent or received for too long
+    kRead,      // an incomplete message stays in recv buffer for too long
+    kConnect,   // an outbound connection is not established in time
+    kCount
+};
+
+/// @brief A timer which can be linked into `TimerWheel`, it is embedded in its owner so arming it never allocates.
+class TimerNode {
+private:
+    friend class TimerWheel;
+
+    TimerNode*  m_prev_;
+    TimerNode*  m_next_;
+    TimerNode** m_slot_;
+    uint64_t    m_expire_tick_;
+public:
+    Connection* const   m_conn_;
+    const TimeoutType   m_type_;
+
+    TimerNode(Connection* conn, TimeoutType type) :
+        m_prev_(nullptr), m_next_(nullptr), m_slot_(nullptr), m_expire_tick_(0), m_conn_(conn), m_type_(type) {};
+
+    TimerNode(const TimerNode&) = delete;
+    TimerNode& operator=(const TimerNode&) = delete;
+
+    /// @brief Check if the timer is armed
+    bool IsLinked() const { return m_slot_ != nullptr; };
+};
+
+/// @brief Hierarchical timer wheel with O(1) schedule / cancel.
+/// @note Level 0 has 256 slots of one tick each, every upper level has 64 slots which cover a whole round of the level below.
+/// Timers in upper levels are moved down when the level below wraps around. It is not thread-safe.
+class TimerWheel {
+private:
+    static constexpr int kLevelCount    = 4;
+    static constexpr int kRootBits      = 8;
+    static constexpr int kLevelBits     = 6;
+    static constexpr size_t kRootSize   = 1 << kRootBits;
+    static constexpr size_t kLevelSize  = 1 << kLevelBits;
+
+    TimerNode*  m_root_[kRootSize];
+    TimerNode*  m_levels_[kLevelCount - 1][kLevelSize];
+
+    uint64_t    m_current_tick_;
+    size_t      m_count_;
+public:
+    TimerWheel(uint64_t current_tick);
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    /// @brief Get the count of armed timers
+    size_t Size() const;
+
+    /// @brief Arm `node` to expire at `expire_tick`, an armed node will be moved
+    void Schedule(TimerNode* node, uint64_t expire_tick);
+
+    /// @brief Disarm `node`, nothing happens if it is not armed
+    void Cancel(TimerNode* node);
+
+    /// @brief Move the wheel forward to `now_tick` and hand every expired node to `expired_func`
+    /// @param expired_func function like `void(TimerNode* node)`, the node is already disarmed when handed
+    template <typename ExpiredFunc>
+    void Advance(uint64_t now_tick, ExpiredFunc&& expired_func);
+
+private:
+    void Link(TimerNode* node);
+    void Unlink(TimerNode* node);
+
+    /// @brief Move all nodes in the slot to their new position
+    void Cascade(TimerNode** slot);
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,129 @@
+#ifndef STC_TIMER_WHEEL_FUNC_HPP
+#define STC_TIMER_WHEEL_FUNC_HPP
+
+#include "TimerWheel.hpp"
+
+namespace SafetyTcpConn {
+
+TimerWheel::TimerWheel(uint64_t current_tick) : m_current_tick_(current_tick), m_count_(0) {
+    for (size_t i = 0; i < kRootSize; i++)
+        m_root_[i] = nullptr;
+    for (int level = 0; level < kLevelCount - 1; level++)
+        for (size_t i = 0; i < kLevelSize; i++)
+            m_levels_[level][i] = nullptr;
+}
+
+inline size_t TimerWheel::Size() const {
+    return m_count_;
+}
+
+inline void TimerWheel::Schedule(TimerNode* node, uint64_t expire_tick) {
+    if (node->IsLinked())
+        Unlink(node);
+
+    // the current tick is handled already, fire at the next tick
+    node->m_expire_tick_ = expire_tick > m_current_tick_ ? expire_tick : m_current_tick_ + 1;
+    Link(node);
+}
+
+inline void TimerWheel::Cancel(TimerNode* node) {
+    if (node->IsLinked())
+        Unlink(node);
+}
+
+template <typename ExpiredFunc>
+inline void TimerWheel::Advance(uint64_t now_tick, ExpiredFunc&& expired_func) {
+    while (m_current_tick_ < now_tick) {
+        m_current_tick_++;
+
+        // level 0 wraps around, move timers down from upper levels
+        const size_t root_index = m_current_tick_ & (kRootSize - 1);
+        if (root_index == 0) {
+            for (int level = 0; level < kLevelCount - 1; level++) {
+                const size_t index = (m_current_tick_ >> (kRootBits + level * kLevelBits)) & (kLevelSize - 1);
+                Cascade(&m_levels_[level][index]);
+
+                // stop when this level doesn't wrap around
+                if (index != 0)
+                    break;
+            }
+        }
+
+        // hand expired nodes
+        TimerNode** slot = &m_root_[root_index];
+        while (*slot != nullptr) {
+            TimerNode* node = *slot;
+            Unlink(node);
+            expired_func(node);
+        }
+    }
+}
+
+inline void TimerWheel::Link(TimerNode* node) {
+    // nodes cascaded down at their expire tick go to the current slot, which is handled right after cascading
+    uint64_t expire_tick = node->m_expire_tick_;
+    if (expire_tick < m_current_tick_)
+        expire_tick = m_current_tick_;
+
+    const uint64_t delta = expire_tick - m_current_tick_;
+
+    TimerNode** slot = nullptr;
+    if (delta < kRootSize) {
+        slot = &m_root_[expire_tick & (kRootSize - 1)];
+    }
+    else {
+        int level = 0;
+        uint64_t level_range = (uint64_t)kRootSize << kLevelBits;
+        while (delta >= level_range && level < kLevelCount - 2) {
+            level++;
+            level_range <<= kLevelBits;
+        }
+
+        // longer than the whole wheel, park it at the farthest slot and it will be cascaded again
+        if (delta >= level_range)
+            expire_tick = m_current_tick_ + level_range - 1;
+
+        slot = &m_levels_[level][(expire_tick >> (kRootBits + level * kLevelBits)) & (kLevelSize - 1)];
+    }
+
+    node->m_slot_ = slot;
+    node->m_prev_ = nullptr;
+    node->m_next_ = *slot;
+    if (*slot != nullptr)
+        (*slot)->m_prev_ = node;
+    *slot = node;
+
+    m_count_++;
+}
+
+inline void TimerWheel::Unlink(TimerNode* node) {
+    if (node->m_prev_ != nullptr)
+        node->m_prev_->m_next_ = node->m_next_;
+    else
+        *node->m_slot_ = node->m_next_;
+
+    if (node->m_next_ != nullptr)
+        node->m_next_->m_prev_ = node->m_prev_;
+
+    node->m_prev_ = nullptr;
+    node->m_next_ = nullptr;
+    node->m_slot_ = nullptr;
+
+    m_count_--;
+}
+
+inline void TimerWheel::Cascade(TimerNode** slot) {
+    TimerNode* node = *slot;
+    *slot = nullptr;
+
+    while (node != nullptr) {
+        TimerNode* next = node->m_next_;
+        m_count_--;
+        Link(node);
+        node = next;
+    }
+}
+
+}
+
+#endif
\ No newline at end of file
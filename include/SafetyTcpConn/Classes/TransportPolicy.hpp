@@ -0,0 +1,41 @@
+#ifndef STC_TRANSPORT_POLICY_HPP
+#define STC_TRANSPORT_POLICY_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Classes.hpp"
+
+namespace SafetyTcpConn {
+
+/// @brief How the connections of an endpoint send and receive, shared by all of them.
+/// @note The default values keep the behaviour of older versions: corked sockets with an 8 KB send buffer,
+/// which suit many small messages but add up to 200 ms to a reply. Start from `LowLatency()` or `Bulk()` for other workloads.
+class TransportPolicy {
+public:
+    int         m_send_quota_;              // `sendmsg` calls for one connection before the send thread moves on to the next one
+    size_t      m_send_chunk_;              // max bytes of one `sendmsg`, the upper bound of adaptive chunks
+    size_t      m_recv_chunk_;              // free space reserved in the recv buffer before each `recv`
+    int         m_send_buffer_;             // `SO_SNDBUF` in bytes, `0` keeps the kernel default which is auto-tuned
+    bool        m_cork_;                    // `TCP_CORK`, hold partial segments until they are full, or for up to 200 ms
+    bool        m_no_delay_;                // `TCP_NODELAY`, send partial segments at once instead of waiting for the ACK of the previous one
+    uint32_t    m_send_stall_timeout_ms_;   // default `kSendStall` timeout of connections, `0` to disable
+    uint32_t    m_connect_timeout_ms_;      // `kConnect` timeout of outbound connections, `0` to wait for the kernel to give up
+    size_t      m_max_buffer_size_;         // max size of recv buffer and of send buffer, the connection is closed when reached
+    bool        m_adaptive_;                // size send chunks and `SO_SNDBUF` from the congestion window and RTT in `TCP_INFO`, `m_send_buffer_` is only the start value
+    size_t      m_high_watermark_;          // buffered bytes to send which run the high watermark function of endpoint, `0` to disable
+    size_t      m_low_watermark_;           // buffered bytes to send which run the drained function after the high watermark is reached
+    size_t      m_zerocopy_threshold_;      // sends of this many bytes or more use `MSG_ZEROCOPY`, `0` to disable
+
+    TransportPolicy();
+
+    /// @brief Request / response traffic: no cork, `TCP_NODELAY`, kernel-tuned send buffer
+    static TransportPolicy LowLatency();
+
+    /// @brief Large transfers: corked, larger recv chunks, send chunks and send buffer follow the congestion window
+    static TransportPolicy Bulk();
+};
+
+}
+
+#endif
\ No newline at end of file
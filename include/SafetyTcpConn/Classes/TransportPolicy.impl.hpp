@@ -0,0 +1,34 @@
+#ifndef STC_TRANSPORT_POLICY_FUNC_HPP
+#define STC_TRANSPORT_POLICY_FUNC_HPP
+
+#include "TransportPolicy.hpp"
+
+namespace SafetyTcpConn {
+
+TransportPolicy::TransportPolicy() :
+    m_send_quota_(10), m_send_chunk_(65536), m_recv_chunk_(1500), m_send_buffer_(8192),
+    m_cork_(true), m_no_delay_(false), m_send_stall_timeout_ms_(5000), m_connect_timeout_ms_(3000), m_max_buffer_size_(65536 * 16),
+    m_adaptive_(false), m_high_watermark_(0), m_low_watermark_(0), m_zerocopy_threshold_(0)
+{}
+
+inline TransportPolicy TransportPolicy::LowLatency() {
+    TransportPolicy policy;
+    policy.m_send_buffer_ = 0;
+    policy.m_cork_ = false;
+    policy.m_no_delay_ = true;
+    return policy;
+}
+
+inline TransportPolicy TransportPolicy::Bulk() {
+    TransportPolicy policy;
+    policy.m_send_chunk_ = 65536 * 4;
+    policy.m_recv_chunk_ = 65536;
+    policy.m_send_buffer_ = 0;
+    policy.m_max_buffer_size_ = 65536 * 64;
+    policy.m_adaptive_ = true;
+    return policy;
+}
+
+}
+
+#endif
\ No newline at end of file
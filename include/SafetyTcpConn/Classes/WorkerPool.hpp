@@ -0,0 +1,81 @@
+#ifndef STC_WORKER_POOL_HPP
+#define STC_WORKER_POOL_HPP
+
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+#include "Classes.hpp"
+
+namespace SafetyTcpConn {
+
+/// @brief Threads which run process functions off the reactors.
+/// @note Every connection is a strand, its process function never runs in two workers at once and runs are not reordered.
+/// A connection is posted to a worker queue in round-robin order, idle workers steal from the back of other queues.
+class WorkerPool {
+private:
+    friend class Core;
+    friend class Reactor;
+
+    // process runs of one strand before it goes to the end of the queue, so a hot connection doesn't starve others
+    static constexpr uint32_t kStrandRounds = 16;
+
+    class Worker {
+    public:
+        std::mutex                  m_mtx_;
+        std::deque<ConnectionPtr>   m_strands_;
+        std::thread                 m_thread_;
+    };
+
+    std::vector<Worker*>    m_workers_;
+    std::atomic_bool        m_open_;
+    std::atomic_size_t      m_next_worker_;
+
+    // for sleeping workers
+    std::atomic_size_t      m_strand_count_;
+    std::atomic_size_t      m_idle_count_;
+    std::mutex              m_mtx_idle_;
+    std::condition_variable m_cond_idle_;
+private:
+    WorkerPool(size_t worker_count);
+
+public:
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /// @brief Get the number of worker threads
+    /// @return `size_t`: worker count
+    size_t WorkerCount();
+
+private:
+    /// @brief Request one process run of the connection, the strand is queued unless it is queued or running already.
+    void Post(const ConnectionPtr& conn);
+
+    /// @brief Request the cleanup function of a closed connection, it runs after the process runs before it.
+    void PostCleanup(const ConnectionPtr& conn);
+
+    /// @brief Finish all queued strands and stop the worker threads.
+    void Stop();
+
+    void Push(const size_t index, const ConnectionPtr& conn);
+
+    /// @brief Take a strand from the front of own queue, or steal one from the back of other queues.
+    ConnectionPtr Take(const size_t index);
+
+    /// @brief Run requested process functions of the strand, up to `kStrandRounds` times.
+    /// @return `bool`: more runs are requested and the strand need to be queued again(`true`) / strand is done(`false`)
+    static bool RunStrand(const ConnectionPtr& conn);
+
+private:
+    static void WorkerLoop(WorkerPool* pool, size_t index);
+};
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,164 @@
+#ifndef STC_WORKER_POOL_FUNC_HPP
+#define STC_WORKER_POOL_FUNC_HPP
+
+#include "Classes.hpp"
+#include "WorkerPool.hpp"
+#include "Connection.hpp"
+#include "Endpoint.hpp"
+
+namespace SafetyTcpConn {
+
+WorkerPool::WorkerPool(size_t worker_count) : m_open_(true), m_next_worker_(0), m_strand_count_(0), m_idle_count_(0) {
+    if (worker_count == 0)
+        worker_count = 1;
+
+    // create all queues before any thread starts stealing from them
+    for (size_t i = 0; i < worker_count; i++)
+        m_workers_.push_back(new Worker());
+    for (size_t i = 0; i < worker_count; i++)
+        m_workers_[i]->m_thread_ = std::thread(WorkerLoop, this, i);
+
+    std::cout << "SafetyTcpConn >> WorkerPool >> Start | Worker Count: " << m_workers_.size() << std::endl;
+}
+
+WorkerPool::~WorkerPool() {
+    Stop();
+
+    for (size_t i = 0; i < m_workers_.size(); i++)
+        delete m_workers_[i];
+    m_workers_.clear();
+
+    std::cout << "SafetyTcpConn >> WorkerPool >> Safety Clean" << std::endl;
+}
+
+inline size_t WorkerPool::WorkerCount() {
+    return m_workers_.size();
+}
+
+inline void WorkerPool::Post(const ConnectionPtr& conn) {
+    // the strand is queued or running already, the running worker will run it again
+    if (conn->m_strand_pending_.fetch_add(1) > 0)
+        return;
+
+    Push(m_next_worker_.fetch_add(1) % m_workers_.size(), conn);
+}
+
+inline void WorkerPool::PostCleanup(const ConnectionPtr& conn) {
+    conn->m_cleanup_pending_.store(true);
+    Post(conn);
+}
+
+inline void WorkerPool::Stop() {
+    m_open_.store(false);
+
+    // wake up all workers, they leave after the queues are empty
+    {
+        std::unique_lock<std::mutex> lck(m_mtx_idle_);
+        m_cond_idle_.notify_all();
+    }
+
+    for (size_t i = 0; i < m_workers_.size(); i++)
+        if (m_workers_[i]->m_thread_.joinable())
+            m_workers_[i]->m_thread_.join();
+}
+
+inline void WorkerPool::Push(const size_t index, const ConnectionPtr& conn) {
+    {
+        std::unique_lock<std::mutex> lck(m_workers_[index]->m_mtx_);
+        m_workers_[index]->m_strands_.push_back(conn);
+    }
+    m_strand_count_.fetch_add(1);
+
+    // only take the lock when someone may be sleeping
+    if (m_idle_count_.load() > 0) {
+        std::unique_lock<std::mutex> lck(m_mtx_idle_);
+        m_cond_idle_.notify_one();
+    }
+}
+
+inline ConnectionPtr WorkerPool::Take(const size_t index) {
+    const size_t worker_count = m_workers_.size();
+
+    for (size_t i = 0; i < worker_count; i++) {
+        Worker* worker = m_workers_[(index + i) % worker_count];
+        std::unique_lock<std::mutex> lck(worker->m_mtx_);
+        if (worker->m_strands_.empty())
+            continue;
+
+        ConnectionPtr conn;
+        // own queue in FIFO order, steal the newest strand of others so their owners keep the older ones
+        if (i == 0) {
+            conn = std::move(worker->m_strands_.front());
+            worker->m_strands_.pop_front();
+        }
+        else {
+            conn = std::move(worker->m_strands_.back());
+            worker->m_strands_.pop_back();
+        }
+        m_strand_count_.fetch_sub(1);
+        return conn;
+    }
+
+    return nullptr;
+}
+
+inline bool WorkerPool::RunStrand(const ConnectionPtr& conn) {
+    uint32_t pending = conn->m_strand_pending_.load();
+
+    for (uint32_t round = 0; round < kStrandRounds; round++) {
+        if (conn->IsConn()) {
+            // one run handles everything received so far, requests made before it are merged
+            const uint64_t start_us = Metrics::NowUs();
+            // the reactor keeps receiving meanwhile, the bytes the process function reads in place are not moved
+            conn->PinRecvBuff();
+            conn->m_funcs_->m_process_func_(conn);
+            conn->UnpinRecvBuff();
+            Metrics::Record(MetricHistogram::kCallbackUs, Metrics::NowUs() - start_us);
+            conn->UpdateReadTimer();
+        }
+        // closed, run cleanup function after all process functions before it
+        else if (conn->m_cleanup_pending_.exchange(false)) {
+            conn->m_funcs_->m_cleanup_func_(conn);
+        }
+
+        // requests made while running are left
+        pending = conn->m_strand_pending_.fetch_sub(pending) - pending;
+        if (pending == 0) {
+            // all input of a half-closed connection is processed
+            if (conn->IsPeerClosed())
+                conn->CloseWhenDrained();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+inline void WorkerPool::WorkerLoop(WorkerPool* pool, size_t index) {
+    while (true) {
+        ConnectionPtr conn = pool->Take(index);
+        if (conn != nullptr) {
+            // rounds used up, go to the end of own queue
+            if (RunStrand(conn))
+                pool->Push(index, conn);
+            continue;
+        }
+
+        // finish queued strands before leaving
+        if (!pool->m_open_.load())
+            break;
+
+        // nothing to run, sleep until a strand is queued
+        std::unique_lock<std::mutex> lck(pool->m_mtx_idle_);
+        pool->m_idle_count_.fetch_add(1);
+        while (pool->m_strand_count_.load() == 0 && pool->m_open_.load())
+            pool->m_cond_idle_.wait(lck);
+        pool->m_idle_count_.fetch_sub(1);
+    }
+
+    std::cout << "SafetyTcpConn >> WorkerPool >> Worker Thread Ended | Worker: " << index << std::endl;
+}
+
+}
+
+#endif
\ No newline at end of file
@@ -3,12 +3,40 @@
 
 #include "Classes/Classes.hpp"
 
+#include "Classes/Metrics.hpp"
+#include "Classes/BufferPool.hpp"
+#include "Classes/ObjectPool.hpp"
+#include "Classes/Buffer.hpp"
+#include "Classes/Scanner.hpp"
+#include "Classes/SendQueue.hpp"
+#include "Classes/TimerWheel.hpp"
+#include "Classes/ContainerTable.hpp"
+#include "Classes/Codec.hpp"
+#include "Classes/TransportPolicy.hpp"
+#include "Classes/IoUring.hpp"
 #include "Classes/Core.hpp"
+#include "Classes/Reactor.hpp"
+#include "Classes/WorkerPool.hpp"
 #include "Classes/Endpoint.hpp"
 #include "Classes/Connection.hpp"
+#include "Classes/ConnectionPool.hpp"
 
+#include "Classes/Metrics.impl.hpp"
+#include "Classes/BufferPool.impl.hpp"
+#include "Classes/ObjectPool.impl.hpp"
+#include "Classes/Buffer.impl.hpp"
+#include "Classes/Scanner.impl.hpp"
+#include "Classes/SendQueue.impl.hpp"
+#include "Classes/TimerWheel.impl.hpp"
+#include "Classes/ContainerTable.impl.hpp"
+#include "Classes/Codec.impl.hpp"
+#include "Classes/TransportPolicy.impl.hpp"
+#include "Classes/IoUring.impl.hpp"
 #include "Classes/Core.impl.hpp"
+#include "Classes/Reactor.impl.hpp"
+#include "Classes/WorkerPool.impl.hpp"
 #include "Classes/Endpoint.impl.hpp"
 #include "Classes/Connection.impl.hpp"
+#include "Classes/ConnectionPool.impl.hpp"
 
 #endif
\ No newline at end of file
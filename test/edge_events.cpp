@@ -0,0 +1,210 @@
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+
+#include <arpa/inet.h>
+#include <poll.h>
+
+#include <SafetyTcpConn/SafetyTcpConn.hpp>
+
+using namespace SafetyTcpConn;
+
+// Edge-triggered event handling of connections, over loopback.
+// lost writable edge: a connection waiting for EPOLLOUT gets EPOLLIN and EPOLLOUT in one event, the rest must still be sent.
+// half-close: input that comes with the end of the peer's stream is processed and answered before closing.
+// usage: TestEdgeEvents [port]
+
+static const size_t kBigSize        = 512 * 1024;   // below the max buffer size, far above the socket buffers
+static const int    kSlowMs         = 300;          // how long "slow" holds the thread running the process function
+static const int    kDeadlineMs     = 3000;         // shorter than the send stall timeout, which hides a lost edge
+
+typedef std::chrono::steady_clock Clock;
+
+static int ElapsedMs(const Clock::time_point& start) {
+    return (int)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+}
+
+static void SleepMs(const int ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+static int ConnectTo(const int port, const int recv_buffer) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    // set before connecting, the window is agreed on the handshake
+    if (recv_buffer > 0)
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &recv_buffer, sizeof(recv_buffer));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool SendString(const int fd, const std::string& data) {
+    return send(fd, data.data(), data.size(), MSG_NOSIGNAL) == (ssize_t)data.size();
+}
+
+// read what is there without waiting
+static size_t Drain(const int fd, std::string& received) {
+    char buff[65536];
+    size_t total = 0;
+    ssize_t ret = 0;
+    while ((ret = recv(fd, buff, sizeof(buff), MSG_DONTWAIT)) > 0) {
+        received.append(buff, ret);
+        total += ret;
+    }
+    return total;
+}
+
+// read until `size` bytes or the end of stream, the deadline is counted from `start`
+// @return `bool`: the peer closed(`true`) / still open(`false`)
+static bool ReadUntil(const int fd, std::string& received, const size_t size, const Clock::time_point& start) {
+    char buff[65536];
+    while (received.size() < size && ElapsedMs(start) < kDeadlineMs) {
+        pollfd pfd{};
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, 50) <= 0)
+            continue;
+
+        ssize_t ret = recv(fd, buff, sizeof(buff), MSG_DONTWAIT);
+        if (ret == 0)
+            return true;
+        if (ret < 0 && errno != EAGAIN && errno != EINTR)
+            return true;
+        if (ret > 0)
+            received.append(buff, ret);
+    }
+    return false;
+}
+
+static bool Report(const char* name, const char* backend, const size_t workers, const bool ok, const std::string& detail) {
+    std::printf("TestEdgeEvents >> %-20s | %-8s | workers: %zu | %s %s\n", name, backend, workers, ok ? "ok" : "FAILED", detail.c_str());
+    return ok;
+}
+
+// the server waits for EPOLLOUT with most of a large message queued, then its reactor is held by "slow"
+// while the client makes room and sends "ping", so readable and writable come in the same event
+static bool TestLostWritable(const int port, const char* backend, const size_t workers) {
+    int fd = ConnectTo(port, 16384);
+    if (fd < 0)
+        return Report("lost writable edge", backend, workers, false, "connect failed");
+
+    // the server fills the socket and waits for EPOLLOUT
+    SendString(fd, "big\r\n");
+    SleepMs(200);
+
+    // hold the reactor, then make room and send more, both readinesses wait for the same `epoll_wait`
+    SendString(fd, "slow\r\n");
+    SleepMs(100);
+    std::string received;
+    for (int i = 0; i < 5; i++) {
+        Drain(fd, received);
+        SleepMs(10);
+    }
+    SendString(fd, "ping\r\n");
+
+    const Clock::time_point start = Clock::now();
+    const bool closed = ReadUntil(fd, received, kBigSize + 6, start);
+    close(fd);
+
+    const bool ok = !closed && received.size() == kBigSize + 6 && received.compare(kBigSize, 6, "pong\r\n") == 0;
+    return Report("lost writable edge", backend, workers, ok,
+        "| received: " + std::to_string(received.size()) + " of " + std::to_string(kBigSize + 6) + " in " + std::to_string(ElapsedMs(start)) + " ms");
+}
+
+// the client sends its request and finishes sending at once, the reply must come before the connection is closed
+static bool TestHalfClose(const int port, const char* backend, const size_t workers, std::atomic_size_t& cleanups) {
+    const size_t cleanups_before = cleanups.load();
+
+    int fd = ConnectTo(port, 0);
+    if (fd < 0)
+        return Report("half-close", backend, workers, false, "connect failed");
+
+    SendString(fd, "slow\r\nping\r\n");
+    shutdown(fd, SHUT_WR);
+
+    const Clock::time_point start = Clock::now();
+    std::string received;
+    bool closed = ReadUntil(fd, received, 6, start);
+    // the reply is complete, the end of stream follows
+    if (!closed)
+        closed = ReadUntil(fd, received, 7, start);
+    close(fd);
+
+    // the cleanup function runs right after closing
+    while (cleanups.load() == cleanups_before && ElapsedMs(start) < kDeadlineMs)
+        SleepMs(1);
+
+    const bool ok = closed && received == "pong\r\n" && cleanups.load() > cleanups_before;
+    return Report("half-close", backend, workers, ok,
+        "| received: \"" + received.substr(0, 4) + "\" closed: " + (closed ? "yes" : "no") + " cleanup: " + (cleanups.load() > cleanups_before ? "yes" : "no"));
+}
+
+static bool RunAll(const int port, const Backend backend, const size_t workers) {
+    const char* backend_name = backend == Backend::kIoUring ? "io_uring" : "epoll";
+    const std::string big(kBigSize, 'x');
+    std::atomic_size_t cleanups(0);
+
+    // small send buffer so that the large message waits for EPOLLOUT, no cork so nothing waits for a full segment
+    TransportPolicy policy;
+    policy.m_cork_ = false;
+    policy.m_no_delay_ = true;
+
+    bool ok = true;
+    {
+        Core core(1, backend, workers);
+        EndpointPtr endpoint = Endpoint::CreateEndpoint(&core, port,
+            [](const ConnectionPtr&) {},
+            [&big](const ConnectionPtr& conn) {
+                bool keep_read = true;
+                while (keep_read) {
+                    const std::string msg = conn->ReadString("\r\n", keep_read);
+                    if (msg == "big")
+                        conn->MsgEnqueue(big.data(), big.size());
+                    else if (msg == "slow")
+                        SleepMs(kSlowMs);
+                    else if (msg == "ping")
+                        conn->MsgEnqueue("pong\r\n", 6);
+                }
+            },
+            [&cleanups](const ConnectionPtr&) {
+                cleanups.fetch_add(1);
+            },
+            policy
+        );
+        SleepMs(100);
+
+        // with workers the reactor is never held by "slow", which only makes the edge case less likely
+        ok = TestLostWritable(port, backend_name, workers) && ok;
+        ok = TestHalfClose(port, backend_name, workers, cleanups) && ok;
+
+        endpoint->CloseEndpoint();
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    const int port = argc > 1 ? atoi(argv[1]) : 18083;
+
+    bool ok = true;
+    ok = RunAll(port, Backend::kEpoll, 0) && ok;
+    ok = RunAll(port + 1, Backend::kEpoll, 2) && ok;
+    ok = RunAll(port + 2, Backend::kIoUring, 0) && ok;
+
+    std::printf("TestEdgeEvents >> %s\n", ok ? "all passed" : "some FAILED");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
\ No newline at end of file
@@ -0,0 +1,220 @@
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+#include <arpa/inet.h>
+#include <poll.h>
+
+#include <SafetyTcpConn/SafetyTcpConn.hpp>
+
+using namespace SafetyTcpConn;
+
+// Reading the recv buffer in place while process functions run on workers, over loopback.
+// peek: the view from `Peek` stays where it is and keeps its bytes while the reactor receives more, nothing is lost after.
+// slow frame: a long `frame_func` doesn't hold up the reactor, other connections are still served meanwhile.
+// usage: TestPeekWorkers [port]
+
+static const size_t kStreamSize     = 2 * 1024 * 1024;  // far above the initial recv buffer, it grows while the views are held
+static const size_t kChunkSize      = 32 * 1024;        // sent every `kChunkMs`, slow enough to stay below the max buffer size
+static const int    kChunkMs        = 5;
+static const int    kHoldMs         = 20;               // how long the process function holds a view
+static const int    kSlowMs         = 600;              // how long "slow" holds its `frame_func`
+static const int    kPingMs         = 300;              // a ping must be answered within this while "slow" runs
+static const int    kDeadlineMs     = 10000;
+
+typedef std::chrono::steady_clock Clock;
+
+static int ElapsedMs(const Clock::time_point& start) {
+    return (int)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+}
+
+static void SleepMs(const int ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+static int ConnectTo(const int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool SendString(const int fd, const std::string& data) {
+    return send(fd, data.data(), data.size(), MSG_NOSIGNAL) == (ssize_t)data.size();
+}
+
+// read until `expected` is received or the end of stream, the deadline is counted from `start`
+static bool ReadReply(const int fd, const std::string& expected, const Clock::time_point& start, const int deadline_ms) {
+    std::string received;
+    char buff[256];
+    while (received.size() < expected.size() && ElapsedMs(start) < deadline_ms) {
+        pollfd pfd{};
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, 10) <= 0)
+            continue;
+
+        ssize_t ret = recv(fd, buff, sizeof(buff), MSG_DONTWAIT);
+        if (ret == 0 || (ret < 0 && errno != EAGAIN && errno != EINTR))
+            break;
+        if (ret > 0)
+            received.append(buff, ret);
+    }
+    return received == expected;
+}
+
+static bool Report(const char* name, const char* backend, const size_t workers, const bool ok, const std::string& detail) {
+    std::printf("TestPeekWorkers >> %-12s | %-8s | workers: %zu | %s %s\n", name, backend, workers, ok ? "ok" : "FAILED", detail.c_str());
+    return ok;
+}
+
+// byte `i` of the stream
+static char StreamByte(const size_t index) {
+    return (char)(index % 251);
+}
+
+// the client streams bytes as fast as it can, the server holds every view for a while and checks it is unchanged after
+static bool TestPeek(const int port, const char* backend, const size_t workers) {
+    std::atomic_size_t consumed(0);
+    std::atomic_size_t moved(0);
+    std::atomic_size_t corrupted(0);
+
+    bool ok = true;
+    {
+        Core core(1, backend == std::string("io_uring") ? Backend::kIoUring : Backend::kEpoll, workers);
+        EndpointPtr endpoint = Endpoint::CreateEndpoint(&core, port,
+            [](const ConnectionPtr&) {},
+            [&](const ConnectionPtr& conn) {
+                const BufferView view = conn->Peek();
+                if (view.Empty())
+                    return;
+
+                const std::string copy = view.ToString();
+                SleepMs(kHoldMs);
+
+                // the reactor received more meanwhile, the view must still be where the bytes are
+                if (conn->Peek().Data() != view.Data())
+                    moved.fetch_add(1);
+                if (std::memcmp(view.Data(), copy.data(), copy.size()) != 0)
+                    corrupted.fetch_add(1);
+
+                const size_t start = consumed.load();
+                for (size_t i = 0; i < copy.size(); i++) {
+                    if (copy[i] != StreamByte(start + i)) {
+                        corrupted.fetch_add(1);
+                        break;
+                    }
+                }
+                consumed.fetch_add(copy.size());
+                conn->Consume(copy.size());
+            },
+            [](const ConnectionPtr&) {}
+        );
+        SleepMs(100);
+
+        int fd = ConnectTo(port);
+        if (fd < 0)
+            return Report("peek", backend, workers, false, "connect failed");
+
+        std::string stream(kStreamSize, 0);
+        for (size_t i = 0; i < kStreamSize; i++)
+            stream[i] = StreamByte(i);
+
+        const Clock::time_point start = Clock::now();
+        for (size_t sent = 0; sent < kStreamSize && ok; sent += kChunkSize) {
+            ok = SendString(fd, stream.substr(sent, kChunkSize));
+            SleepMs(kChunkMs);
+        }
+        while (consumed.load() < kStreamSize && ElapsedMs(start) < kDeadlineMs)
+            SleepMs(10);
+        close(fd);
+
+        ok = ok && consumed.load() == kStreamSize && moved.load() == 0 && corrupted.load() == 0;
+        Report("peek", backend, workers, ok,
+            "| consumed: " + std::to_string(consumed.load()) + " of " + std::to_string(kStreamSize) +
+            " moved: " + std::to_string(moved.load()) + " corrupted: " + std::to_string(corrupted.load()));
+
+        endpoint->CloseEndpoint();
+    }
+    return ok;
+}
+
+// one connection runs a long `frame_func` and keeps sending to it, another one pings the same reactor meanwhile
+static bool TestSlowFrame(const int port, const char* backend, const size_t workers) {
+    // no cork so that the reply doesn't wait for a full segment
+    TransportPolicy policy;
+    policy.m_cork_ = false;
+    policy.m_no_delay_ = true;
+
+    bool ok = true;
+    {
+        Core core(1, backend == std::string("io_uring") ? Backend::kIoUring : Backend::kEpoll, workers);
+        EndpointPtr endpoint = Endpoint::CreateEndpoint(&core, port,
+            [](const ConnectionPtr&) {},
+            [](const ConnectionPtr& conn) {
+                conn->ReadStrings("\r\n", [&conn](const BufferView& msg) {
+                    if (msg.ToString() == "slow")
+                        SleepMs(kSlowMs);
+                    else if (msg.ToString() == "ping")
+                        conn->MsgEnqueue("pong\r\n", 6);
+                });
+            },
+            [](const ConnectionPtr&) {},
+            policy
+        );
+        SleepMs(100);
+
+        int slow_fd = ConnectTo(port);
+        int ping_fd = ConnectTo(port);
+        if (slow_fd < 0 || ping_fd < 0)
+            return Report("slow frame", backend, workers, false, "connect failed");
+        SleepMs(50);
+
+        // the reactor receives for the slow connection while its `frame_func` runs
+        SendString(slow_fd, "slow\r\n");
+        SleepMs(50);
+        SendString(slow_fd, "more\r\n");
+        SleepMs(50);
+
+        const Clock::time_point start = Clock::now();
+        SendString(ping_fd, "ping\r\n");
+        const bool answered = ReadReply(ping_fd, "pong\r\n", start, kPingMs);
+        const int elapsed_ms = ElapsedMs(start);
+        close(slow_fd);
+        close(ping_fd);
+
+        ok = answered;
+        Report("slow frame", backend, workers, ok, "| pong in " + std::to_string(elapsed_ms) + " ms");
+
+        endpoint->CloseEndpoint();
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    const int port = argc > 1 ? atoi(argv[1]) : 18093;
+
+    bool ok = true;
+    ok = TestPeek(port, "epoll", 2) && ok;
+    ok = TestPeek(port + 1, "io_uring", 2) && ok;
+    ok = TestSlowFrame(port + 2, "epoll", 2) && ok;
+    ok = TestSlowFrame(port + 3, "io_uring", 2) && ok;
+
+    std::printf("TestPeekWorkers >> %s\n", ok ? "all passed" : "some FAILED");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}